@@ -4,7 +4,6 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <sys/time.h>
-#include <mach/mach_time.h>
 
 // High-precision timing utilities
 typedef struct {
@@ -31,6 +30,16 @@ typedef struct {
     size_t compressed_size;
 } benchmark_result_t;
 
+// Frequency counting throughput: the dispatched kernel against a plain
+// single-table loop
+typedef struct {
+    const char* name;
+    size_t data_size;
+    double kernel_gbps;
+    double baseline_gbps;
+    const char* kernel_variant;
+} histogram_benchmark_t;
+
 // Timer functions
 void benchmark_timer_init(benchmark_timer_t* timer);
 void benchmark_timer_start(benchmark_timer_t* timer);
@@ -46,6 +55,12 @@ benchmark_result_t benchmark_compression(const char* test_name,
 void benchmark_print_result(const benchmark_result_t* result);
 void benchmark_print_header(void);
 
+histogram_benchmark_t benchmark_histogram(const char* test_name,
+                                          const uint8_t* data, size_t data_size,
+                                          int iterations);
+void benchmark_print_histogram_header(void);
+void benchmark_print_histogram_result(const histogram_benchmark_t* result);
+
 // Test data generation
 uint8_t* generate_random_data(size_t size);
 uint8_t* generate_text_data(size_t size);
@@ -55,5 +70,6 @@ uint8_t* generate_binary_data(size_t size);
 // System info
 void print_system_info(void);
 void print_cpu_info(void);
+void print_kernel_info(void);
 
 #endif
\ No newline at end of file
@@ -5,6 +5,11 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+
+// Readable bytes past the end of the data that let the fast refill run all
+// the way to the end of the stream (see bit_stream_create_padded)
+#define BIT_STREAM_PADDING 8
 
 typedef struct bit_stream {
     uint8_t* data;
@@ -13,9 +18,24 @@ typedef struct bit_stream {
     uint8_t bit_pos;
     uint64_t bit_buffer;
     uint8_t bits_in_buffer;
+    size_t readable_size;     // data_size plus any readable padding after it
 } bit_stream_t;
 
+// Caller-owned stream (e.g. on the stack) over data; no allocation. The
+// caller guarantees `padding` more readable bytes after data[size - 1].
+static inline void bit_stream_init(bit_stream_t* stream, const uint8_t* data, size_t size, size_t padding) {
+    stream->data = (uint8_t*)data;
+    stream->data_size = size;
+    stream->byte_pos = 0;
+    stream->bit_pos = 0;
+    stream->bit_buffer = 0;
+    stream->bits_in_buffer = 0;
+    stream->readable_size = size + padding;
+}
+
 bit_stream_t* bit_stream_create(uint8_t* data, size_t size);
+// The caller guarantees `padding` more readable bytes after data[size - 1]
+bit_stream_t* bit_stream_create_padded(uint8_t* data, size_t size, size_t padding);
 void bit_stream_destroy(bit_stream_t* stream);
 bool bit_stream_read_bit(bit_stream_t* stream);
 uint32_t bit_stream_read_bits(bit_stream_t* stream, uint8_t num_bits);
@@ -27,6 +47,38 @@ uint32_t bit_stream_peek_bits(bit_stream_t* stream, uint8_t num_bits);
 void bit_stream_skip_bits(bit_stream_t* stream, uint8_t num_bits);
 int bit_stream_available_bits(bit_stream_t* stream);
 
+// Fast refill mode: one unaligned 8-byte load at the byte holding the next
+// unread bit and a shift, with no loop and no data-dependent branch. Leaves
+// 57-64 bits buffered, so a decode loop can take several codes per refill
+// without checking for the end of the data. Valid only while
+// bit_stream_can_refill_fast() holds; near the end of unpadded data fall
+// back to bit_stream_fill_buffer().
+static inline bool bit_stream_can_refill_fast(const bit_stream_t* stream) {
+    size_t next_byte = stream->byte_pos - ((stream->bits_in_buffer + 7u) >> 3);
+    return next_byte + sizeof(uint64_t) <= stream->readable_size;
+}
+
+static inline void bit_stream_refill_fast(bit_stream_t* stream) {
+    size_t position = stream->byte_pos * 8 - stream->bits_in_buffer;
+    size_t next_byte = position >> 3;
+    
+    uint64_t chunk;
+    memcpy(&chunk, &stream->data[next_byte], sizeof(chunk));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    chunk = __builtin_bswap64(chunk);
+#endif
+    
+    stream->bit_buffer = chunk << (position & 7);
+    stream->bits_in_buffer = 64 - (position & 7);
+    stream->byte_pos = next_byte + sizeof(uint64_t);
+}
+
+// Bits consumed so far. Past data_size * 8 the decoder has read padding,
+// i.e. the data was truncated.
+static inline size_t bit_stream_consumed_bits(const bit_stream_t* stream) {
+    return stream->byte_pos * 8 - stream->bits_in_buffer;
+}
+
 // ITERATION 3: NEON SIMD batch processing functions
 #ifdef __aarch64__
 int bit_stream_read_bits_batch(bit_stream_t* stream, uint8_t* bit_counts, uint32_t* results, int batch_size);
@@ -0,0 +1,68 @@
+#ifndef BLOCK_CONTAINER_H
+#define BLOCK_CONTAINER_H
+
+#include "huffman_compress.h"
+#include "file_format.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Version 2 block container (layout in file_format.h). Every block has its
+// own table, so heterogeneous input adapts block by block, and blocks decode
+// independently of each other.
+
+// Whole container for data_size bytes, in a new buffer. 0 on success.
+// options->threads encodes blocks concurrently; the bytes do not change.
+int huffman_compress_blocks(const uint8_t* data, size_t data_size,
+                            const huffman_compress_options_t* options,
+                            uint8_t** output, size_t* output_size);
+
+// Decode a whole container, checking every block's CRC and the file CRC
+int huffman_decompress_blocks(const uint8_t* input, size_t input_size,
+                              const huffman_decompress_options_t* options,
+                              uint8_t** output, size_t* output_size);
+
+// Validated view of a container's header, trailer and index. entries points
+// into the input buffer, one per block in file order.
+typedef struct huffman_block_index {
+    huffman_header_t header;  // Sizes and CRC filled in from the trailer when streamed
+    huffman_index_trailer_t trailer;
+    const huffman_index_entry_t* entries;
+    size_t index_offset;      // File offset of the first index entry
+    size_t blocks_end;        // File offset just past the last block
+} huffman_block_index_t;
+
+int huffman_read_block_index(const uint8_t* input, size_t input_size, huffman_block_index_t* index);
+
+// Decode block `block` of a container into output, which holds exactly that
+// block's original size (the gap to the next entry's original offset)
+int huffman_decode_block(const uint8_t* input, const huffman_block_index_t* index, size_t block,
+                         uint8_t* output, size_t output_size);
+
+// Decode every block into output, which holds the header's original_size
+// bytes, and check the file CRC. With output mapped from the destination
+// file this decodes straight into the page cache. Blocks land in disjoint
+// parts of output, so up to `threads` threads decode and check them at once.
+int huffman_decode_blocks(const uint8_t* input, const huffman_block_index_t* index, unsigned threads,
+                          uint8_t* output);
+
+// Random access: decode original bytes [start, end) into output, which holds
+// end - start bytes. Block boundaries are the sync points, so only blocks
+// overlapping the range are decoded, each checked against its CRC; the file
+// CRC covers all the data and is not checked. The range must lie within the
+// original data.
+int huffman_decode_range(const uint8_t* input, const huffman_block_index_t* index,
+                         uint64_t start, uint64_t end, uint8_t* output);
+
+// Streaming: one block per thread in memory at a time, whatever the input
+// size. The compressor reads input to EOF and writes the container, going
+// back to fill in the header when output is seekable (the file then matches
+// huffman_compress_blocks byte for byte) and writing a streamed container
+// otherwise. The decompressor reads a container front to back, writing each
+// block once its CRC checks, and verifies the index and trailer at the end.
+// Version 1 input is decoded whole. Sizes are optional outputs.
+int huffman_compress_stream(FILE* input, FILE* output, const huffman_compress_options_t* options,
+                            uint64_t* original_size, uint64_t* compressed_size);
+int huffman_decompress_stream(FILE* input, FILE* output, uint64_t* original_size);
+
+#endif
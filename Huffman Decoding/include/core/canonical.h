@@ -0,0 +1,35 @@
+#ifndef CANONICAL_H
+#define CANONICAL_H
+
+#include "bit_stream.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define CANONICAL_MAX_SYMBOLS 256
+#define CANONICAL_MAX_LENGTH 32
+
+// Canonical Huffman: codes are assigned in (length, symbol) order, so the
+// code lengths alone determine every code.
+//
+// Tree-free decoder state, rebuilt from code lengths. limit[len] is one past
+// the last code of length len, left-justified to 32 bits (widened so a
+// complete code's final limit of 2^32 still fits): a left-justified peek
+// below limit[len] starts with a code of at most len bits.
+typedef struct canonical_decoder {
+    uint64_t limit[CANONICAL_MAX_LENGTH + 1];
+    uint32_t first_code[CANONICAL_MAX_LENGTH + 1];  // First code of each length
+    uint16_t offset[CANONICAL_MAX_LENGTH + 1];      // Index of that code's symbol
+    uint8_t symbols[CANONICAL_MAX_SYMBOLS];         // Symbols in (length, symbol) order
+    uint8_t min_length;
+    uint8_t max_length;                             // 0 when not built
+} canonical_decoder_t;
+
+// Assign canonical codes from per-symbol lengths (0 = unused symbol).
+// Returns -1 if a length exceeds CANONICAL_MAX_LENGTH or the lengths are
+// over-subscribed.
+int canonical_codes_from_lengths(const uint8_t* code_lengths, uint32_t* codes);
+
+int canonical_decoder_build(canonical_decoder_t* decoder, const uint8_t* code_lengths);
+int canonical_decode_symbol(const canonical_decoder_t* decoder, bit_stream_t* stream, uint8_t* symbol);
+
+#endif
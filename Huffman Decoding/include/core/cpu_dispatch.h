@@ -0,0 +1,47 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include "decoder.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// CPU features probed at startup: cpuid on x86-64, getauxval (Linux) or the
+// platform baseline (Apple) on ARM64
+#define CPU_FEATURE_SSE42    (1u << 0)
+#define CPU_FEATURE_PCLMUL   (1u << 1)
+#define CPU_FEATURE_BMI2     (1u << 2)
+#define CPU_FEATURE_NEON     (1u << 3)
+#define CPU_FEATURE_CRC32    (1u << 4)   // ARMv8 CRC32 instructions
+#define CPU_FEATURE_PMULL    (1u << 5)   // ARMv8 64-bit polynomial multiply
+
+// Kernels picked for this CPU, with the name of each variant. Built once on
+// first use; setting HUFFMAN_DISPATCH=scalar in the environment masks every
+// feature so the portable versions run instead. The PMULL CRC kernel has not
+// yet been run on an ARM64 host, so it is only picked with
+// HUFFMAN_DISPATCH=pmull.
+typedef struct huffman_kernels {
+    uint32_t cpu_features;
+    
+    size_t (*decode_symbols)(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* output, size_t count);
+    int (*decode_interleaved)(huffman_decoder_t* decoder, bit_stream_t* const* streams, uint8_t* output, size_t count);
+    // Adds the byte counts of data to frequencies[256]
+    void (*count_frequencies)(uint64_t* frequencies, const uint8_t* data, size_t length);
+    // Raw CRC-32 register update, without the initial and final inversion
+    uint32_t (*crc32_update)(uint32_t crc, const uint8_t* data, size_t length);
+    
+    const char* decode_variant;
+    const char* histogram_variant;
+    const char* crc32_variant;
+} huffman_kernels_t;
+
+const huffman_kernels_t* huffman_kernels(void);
+
+// Comma-separated names of the features in `features`, e.g. "sse4.2,pclmul"
+void cpu_features_describe(uint32_t features, char* buffer, size_t size);
+
+// Selection hooks: each module fills in its own kernels for the features
+void decoder_select_kernels(uint32_t features, huffman_kernels_t* kernels);
+void frequency_select_kernel(uint32_t features, huffman_kernels_t* kernels);
+void crc32_select_kernel(uint32_t features, huffman_kernels_t* kernels);
+
+#endif
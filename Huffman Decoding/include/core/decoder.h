@@ -3,6 +3,7 @@
 
 #include "huffman_tree.h"
 #include "bit_stream.h"
+#include "canonical.h"
 #include <stdint.h>
 #include <stddef.h>
 
@@ -27,17 +28,41 @@ static inline uint64_t arm64_rbit64(uint64_t x) {
 }
 #endif
 
-// Cache-optimized lookup table entry (64-byte aligned)
-typedef struct __attribute__((packed, aligned(64))) lookup_entry {
-    uint8_t symbol;           // Decoded symbol
-    uint8_t code_length;      // Length of code in bits
-    uint16_t padding;         // Padding for alignment
+// Compact 16-bit lookup table entry. Tables are contiguous arrays of these,
+// so the 4096-entry direct table is 8KB and stays resident in L1; only the
+// table itself is 64-byte aligned, never the individual entries.
+typedef struct lookup_entry {
+    uint8_t symbol;           // Decoded symbol (subtable offset for links)
+    uint8_t code_length;      // Length of code in bits (LOOKUP_SUBTABLE for links)
 } lookup_entry_t;
 
+_Static_assert(sizeof(lookup_entry_t) == 2, "lookup_entry_t must stay 16 bits");
+
+// First-level entries with LOOKUP_SUBTABLE set in code_length link to a
+// second-level subtable: the low bits of code_length give its width and
+// symbol gives its offset in overflow_table in units of that width.
+#define LOOKUP_SUBTABLE 0x80
+#define LOOKUP_SUBTABLE_BITS(code_length) ((code_length) & 0x7F)
+
+// Multi-symbol lookup entry: every whole code that fits in the direct_bits
+// window, up to MULTI_LOOKUP_MAX_SYMBOLS of them, decoded by a single probe.
+// The decoder copies all 4 bytes to the output and advances by the count.
+#define MULTI_LOOKUP_MAX_SYMBOLS 3
+#define MULTI_LOOKUP_COUNT(info) ((info) >> 4)
+#define MULTI_LOOKUP_BITS(info) ((info) & 0x0F)
+
+typedef struct multi_lookup_entry {
+    uint8_t symbols[MULTI_LOOKUP_MAX_SYMBOLS];  // Decoded symbols in stream order
+    uint8_t info;                               // count << 4 | total code bits
+} multi_lookup_entry_t;
+
+_Static_assert(sizeof(multi_lookup_entry_t) == 4, "multi_lookup_entry_t must stay 32 bits");
+
 // ITERATION 3: Vectorized lookup table for fast symbol decoding
 typedef struct __attribute__((aligned(64))) vectorized_lookup_table {
-    lookup_entry_t* direct_table;    // 12-bit direct lookup (4096 entries)
-    lookup_entry_t* overflow_table;  // Overflow for longer codes
+    lookup_entry_t* direct_table;    // 12-bit direct lookup (4096 entries, 8KB)
+    lookup_entry_t* overflow_table;  // Second-level subtables for longer codes
+    multi_lookup_entry_t* multi_table; // Optional multi-symbol table (direct_size entries)
     size_t direct_size;              // Size of direct table
     size_t overflow_size;            // Size of overflow table
     uint8_t max_code_length;         // Maximum code length in bits
@@ -51,15 +76,50 @@ typedef struct huffman_decoder {
     size_t output_capacity;
     // ITERATION 3: NEON SIMD vectorized lookup table for fast decoding
     vectorized_lookup_table_t* lookup_table;
+    // Limit/offset decoder for canonical codes; replaces the tree when tree is NULL
+    canonical_decoder_t canonical;
 } huffman_decoder_t;
 
 huffman_decoder_t* huffman_decoder_create(huffman_tree_t* tree);
+// Tree-free decoder for canonical codes, built from per-symbol code lengths
+huffman_decoder_t* huffman_decoder_create_canonical(const uint8_t* code_lengths);
 void huffman_decoder_destroy(huffman_decoder_t* decoder);
+
+// Caller-owned decoder (e.g. on the stack) over a lookup table the caller
+// keeps alive; no allocation. It has no output buffer, so it only drives the
+// table engines (huffman_decode_symbols / huffman_decode_interleaved), and it
+// must not be passed to huffman_decoder_destroy.
+static inline void huffman_decoder_init(huffman_decoder_t* decoder, vectorized_lookup_table_t* table) {
+    decoder->tree = NULL;
+    decoder->output_buffer = NULL;
+    decoder->output_size = 0;
+    decoder->output_capacity = 0;
+    decoder->lookup_table = table;
+    decoder->canonical.max_length = 0;
+}
 int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** output, size_t* output_size);
 int huffman_decode_symbol(huffman_tree_t* tree, bit_stream_t* stream, uint8_t* symbol);
 
+// Table-driven decode of exactly `count` symbols; returns the number decoded
+size_t huffman_decode_symbols(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* output, size_t count);
+
+// Interleaved streams: `count` symbols are split into HUFFMAN_INTERLEAVE_STREAMS
+// contiguous segments of huffman_interleave_segment(count) symbols (the last
+// takes the remainder), each coded as its own independent bit stream.
+#define HUFFMAN_INTERLEAVE_STREAMS 4
+
+static inline size_t huffman_interleave_segment(size_t count) {
+    return (count + HUFFMAN_INTERLEAVE_STREAMS - 1) / HUFFMAN_INTERLEAVE_STREAMS;
+}
+
+// Decode all segments, advancing the streams in one loop; 0 on success
+int huffman_decode_interleaved(huffman_decoder_t* decoder, bit_stream_t* const* streams, uint8_t* output, size_t count);
+
 // ITERATION 3: NEON SIMD vectorized lookup table functions
 vectorized_lookup_table_t* create_vectorized_lookup_table(huffman_tree_t* tree);
+vectorized_lookup_table_t* create_lookup_table_with_bits(huffman_tree_t* tree, uint8_t direct_bits);
+vectorized_lookup_table_t* create_lookup_table_from_lengths(const uint8_t* code_lengths, uint8_t direct_bits);
+int build_multi_symbol_table(vectorized_lookup_table_t* table);
 void destroy_vectorized_lookup_table(vectorized_lookup_table_t* table);
 int vectorized_decode_symbol(vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbol);
 
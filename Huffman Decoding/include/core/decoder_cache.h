@@ -0,0 +1,44 @@
+#ifndef DECODER_CACHE_H
+#define DECODER_CACHE_H
+
+#include "decoder.h"
+#include "file_format.h"
+#include "encoder.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Bounded LRU cache of ready-built decoders, keyed by the stored symbol
+// table. Messages that share a table skip the tree, lookup table and
+// multi-symbol table builds entirely.
+#define DECODER_CACHE_DEFAULT_ENTRIES 16
+#define DECODER_CACHE_MAX_ENTRIES 64
+
+typedef struct decoder_cache_entry {
+    uint64_t hash;                           // FNV-1a of the symbol table bytes
+    symbol_info_t symbol_table[MAX_SYMBOLS]; // Key, compared in full on a hash match
+    size_t symbol_count;
+    huffman_decoder_t* decoder;
+    huffman_tree_t* tree;                    // Legacy non-canonical tables only
+    uint64_t last_used;
+    unsigned refs;                           // Acquired and not yet released
+    bool multi_built;                        // Multi-symbol build ran, whether or not the table was kept
+    bool cached;                             // False: freed on last release
+} decoder_cache_entry_t;
+
+// Decoder for a stored symbol table, from the cache or freshly built. The
+// decoder is shared and must only be used through the table engines
+// (huffman_decode_symbols / huffman_decode_interleaved); give it back with
+// decoder_cache_release. Outputs of at least expected_size bytes get the
+// multi-symbol table. Returns NULL if the table is invalid.
+decoder_cache_entry_t* decoder_cache_acquire(const symbol_info_t* symbol_table, size_t symbol_count,
+                                             size_t expected_size);
+void decoder_cache_release(decoder_cache_entry_t* entry);
+
+// Entries kept (0 disables caching, capped at DECODER_CACHE_MAX_ENTRIES)
+void decoder_cache_set_capacity(size_t capacity);
+// Free every entry not currently acquired
+void decoder_cache_clear(void);
+void decoder_cache_stats(size_t* hits, size_t* misses);
+
+#endif
@@ -24,14 +24,6 @@ typedef struct code_table {
     uint8_t max_length;
 } code_table_t;
 
-typedef struct encoder_node {
-    uint64_t frequency;
-    uint8_t symbol;
-    bool is_leaf;
-    struct encoder_node* left;
-    struct encoder_node* right;
-} encoder_node_t;
-
 typedef struct bit_writer {
     uint8_t* buffer;
     size_t buffer_size;
@@ -44,13 +36,22 @@ typedef struct bit_writer {
 frequency_table_t* frequency_table_create(void);
 void frequency_table_destroy(frequency_table_t* table);
 int frequency_table_analyze(frequency_table_t* table, const uint8_t* data, size_t length);
+// Same counts plus the CRC32 of data, taken chunk by chunk right after each
+// chunk is counted, while it is still in cache
+int frequency_table_analyze_checksum(frequency_table_t* table, const uint8_t* data, size_t length,
+                                     uint32_t* checksum);
 
-// Huffman tree building
-encoder_node_t* build_huffman_tree(const frequency_table_t* freq_table);
-void destroy_encoder_tree(encoder_node_t* root);
-
-// Code generation
-code_table_t* generate_codes(encoder_node_t* root);
+// Code construction: per-symbol Huffman code lengths (0 = unused symbol),
+// then the canonical codes for them
+int build_code_lengths(const frequency_table_t* freq_table, uint8_t* code_lengths);
+// Optimal lengths of at most max_length bits (package-merge when plain
+// Huffman runs deeper). -1 if 2^max_length codes cannot cover the symbols.
+int build_limited_code_lengths(const frequency_table_t* freq_table, uint8_t max_length,
+                               uint8_t* code_lengths);
+// Smallest max_length that can code symbol_count symbols: ceil(log2(count)),
+// and 1 for a single symbol
+uint8_t huffman_min_code_length(size_t symbol_count);
+code_table_t* code_table_from_lengths(const uint8_t* code_lengths);
 void code_table_destroy(code_table_t* table);
 
 // Canonical Huffman
@@ -64,4 +65,12 @@ int bit_writer_write_code(bit_writer_t* writer, const huffman_code_t* code);
 int bit_writer_flush(bit_writer_t* writer);
 uint8_t* bit_writer_get_data(bit_writer_t* writer, size_t* size);
 
+// Word-at-a-time encoding into a caller-sized buffer. The output needs
+// (encoded bits + 7) / 8 bytes plus ENCODE_OUTPUT_SLACK, since whole 64-bit
+// words are stored past the last completed byte; there are no capacity
+// checks while encoding. Returns the bytes written, padded to a whole byte.
+#define ENCODE_OUTPUT_SLACK 8
+uint64_t code_table_encoded_bits(const code_table_t* table, const frequency_table_t* freq_table);
+size_t huffman_encode_into(const code_table_t* table, const uint8_t* data, size_t size, uint8_t* output);
+
 #endif
\ No newline at end of file
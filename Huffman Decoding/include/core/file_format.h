@@ -6,7 +6,17 @@
 #include <stdio.h>
 
 #define HUFFMAN_MAGIC 0x48554646  // "HUFF"
-#define HUFFMAN_VERSION 1
+#define HUFFMAN_VERSION 2         // Block container (see below)
+#define HUFFMAN_VERSION_SINGLE 1  // One table and one bit stream; still read
+
+// Header flags
+#define HUFFMAN_FLAG_INTERLEAVED 0x0001  // Data split into 4 independent bit streams
+#define HUFFMAN_FLAG_STREAMED    0x0004  // Version 2 written to an unseekable output (below)
+#define HUFFMAN_KNOWN_FLAGS (HUFFMAN_FLAG_INTERLEAVED | HUFFMAN_FLAG_STREAMED)
+
+// Interleaved data starts with a jump table of the byte sizes of the first
+// three streams; the fourth stream runs to the end of the compressed data
+#define HUFFMAN_JUMP_TABLE_SIZE (3 * sizeof(uint32_t))
 
 typedef struct huffman_header {
     uint32_t magic;           // Magic number: "HUFF"
@@ -29,11 +39,81 @@ typedef struct symbol_info {
 // [huffman_header_t]
 // [symbol_info_t array] - sorted by symbol value
 // [compressed bit stream]
+//
+// With HUFFMAN_FLAG_INTERLEAVED the compressed bit stream is instead:
+// [uint32_t stream sizes x3][stream 0][stream 1][stream 2][stream 3]
+// where stream k codes the k-th quarter of the original data, each padded
+// to a whole byte.
+
+// Version 2 splits the input into blocks that decode independently, each
+// with its own table and checksum, followed by an index for seeking:
+// [huffman_header_t]                 symbol_count = 0, sizes and CRC of the whole file
+// [block 0] ... [block n-1]          each laid out as below
+// [huffman_index_entry_t x n]
+// [huffman_index_trailer_t]          fixed size, at the very end of the file
+//
+// A block is [huffman_block_header_t][symbol table][payload], the payload
+// being a version 1 bit stream (interleaved when flagged). The symbol table is
+// symbol_info_t x symbol_count, or with HUFFMAN_BLOCK_FLAG_PACKED_LENGTHS only
+// the canonical code lengths:
+// [uint8_t first symbol][uint8_t last symbol][4-bit lengths, first to last]
+// two per byte, low nibble first, 0 for unused symbols. Codes are then
+// assigned in (length, symbol) order, as make_canonical does.
+//
+// A container written to an output that cannot seek back (a pipe) has
+// HUFFMAN_FLAG_STREAMED set and 0 for the sizes and CRC in its header, which
+// went out before they were known; the trailer carries them instead, and an
+// all-zero huffman_block_header_t after the last block marks the end of the
+// blocks for readers that never see the index.
+#define HUFFMAN_INDEX_MAGIC 0x58444948  // "HIDX"
+
+#define HUFFMAN_DEFAULT_BLOCK_SIZE (256 * 1024)
+#define HUFFMAN_MIN_BLOCK_SIZE (4 * 1024)
+#define HUFFMAN_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+// Block flags, beside HUFFMAN_FLAG_INTERLEAVED
+#define HUFFMAN_BLOCK_FLAG_PACKED_LENGTHS 0x0002  // Table holds code lengths only
+#define HUFFMAN_BLOCK_KNOWN_FLAGS (HUFFMAN_FLAG_INTERLEAVED | HUFFMAN_BLOCK_FLAG_PACKED_LENGTHS)
+#define HUFFMAN_PACKED_MAX_LENGTH 15  // Longest code a nibble can hold
+
+typedef struct huffman_block_header {
+    uint32_t original_size;   // Uncompressed bytes in this block
+    uint32_t compressed_size; // Payload bytes after the symbol table
+    uint32_t checksum;        // CRC32 of this block's original data
+    uint16_t symbol_count;    // Entries in this block's symbol table
+    uint16_t flags;           // HUFFMAN_FLAG_INTERLEAVED, HUFFMAN_BLOCK_FLAG_PACKED_LENGTHS
+} __attribute__((packed)) huffman_block_header_t;
+
+typedef struct huffman_index_entry {
+    uint64_t original_offset; // Uncompressed offset of the block's first byte
+    uint64_t block_offset;    // File offset of the block header
+} __attribute__((packed)) huffman_index_entry_t;
+
+typedef struct huffman_index_trailer {
+    uint64_t original_size;   // Total uncompressed size
+    uint32_t block_count;     // Index entries before the trailer
+    uint32_t block_size;      // Uncompressed bytes per block; the last may be short
+    uint32_t checksum;        // CRC32 of the whole original data
+    uint32_t magic;           // HUFFMAN_INDEX_MAGIC
+} __attribute__((packed)) huffman_index_trailer_t;
 
 int huffman_write_header(FILE* file, const huffman_header_t* header);
 int huffman_read_header(FILE* file, huffman_header_t* header);
 int huffman_write_symbol_table(FILE* file, const symbol_info_t* symbols, size_t count);
 int huffman_read_symbol_table(FILE* file, symbol_info_t* symbols, size_t count);
 uint32_t calculate_crc32(const uint8_t* data, size_t length);
+// CRC32 of A followed by B, from the CRCs of A and B and B's length, without
+// touching the data again
+uint32_t calculate_crc32_combine(uint32_t crc_a, uint32_t crc_b, uint64_t length_b);
+
+// Packed code-length tables (per-symbol lengths, 0 = unused). The size is 0
+// when a length is over HUFFMAN_PACKED_MAX_LENGTH or no symbol is used.
+size_t huffman_packed_lengths_size(const uint8_t* code_lengths);
+size_t huffman_pack_lengths(const uint8_t* code_lengths, uint8_t* output);
+// Unpack from at most input_size bytes; *consumed is the table's size
+int huffman_unpack_lengths(const uint8_t* input, size_t input_size, uint8_t* code_lengths, size_t* consumed);
+// Expand lengths into a canonical symbol table, in symbol order. Returns the
+// number of symbols, or -1 when the lengths do not form a prefix code.
+int huffman_symbols_from_lengths(const uint8_t* code_lengths, symbol_info_t* symbols);
 
 #endif
\ No newline at end of file
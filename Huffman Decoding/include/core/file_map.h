@@ -0,0 +1,24 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Whole-file memory mappings. Input is mapped read-only and read straight
+// from the page cache; output is sized with ftruncate and mapped shared, so
+// whatever is written into data lands in the file with no buffer or copy
+// in between.
+typedef struct file_map {
+    uint8_t* data;    // NULL for an empty file, which is never mapped
+    size_t size;
+    int fd;
+} file_map_t;
+
+// Map an existing file for sequential reading. 0 on success.
+int file_map_open_read(const char* path, file_map_t* map);
+// Create or truncate path to exactly size bytes and map it for writing
+int file_map_create(const char* path, size_t size, file_map_t* map);
+// Unmap and close. Written mappings are flushed to the file by the kernel.
+void file_map_close(file_map_t* map);
+
+#endif
@@ -8,14 +8,32 @@
 
 // High-level compression/decompression interface
 
+// Input size from which data is written as interleaved streams
+#ifndef INTERLEAVE_MIN_INPUT
+#define INTERLEAVE_MIN_INPUT 1024
+#endif
+
 typedef struct huffman_context {
     frequency_table_t* freq_table;
     code_table_t* code_table;
-    encoder_node_t* tree_root;
     huffman_tree_t* decode_tree;
-    bit_writer_t* writer;
 } huffman_context_t;
 
+// Most worker threads a block container compress or decompress will use
+#define HUFFMAN_MAX_THREADS 256
+
+// Compressor settings; zero-initialized means the defaults
+typedef struct huffman_compress_options {
+    uint8_t max_code_length;  // Longest code allowed (0 = MAX_CODE_LENGTH)
+    size_t block_size;        // Block container block size (0 = HUFFMAN_DEFAULT_BLOCK_SIZE)
+    unsigned threads;         // Block container threads, output unaffected (0 or 1 = caller only)
+} huffman_compress_options_t;
+
+// Decompressor settings; zero-initialized means the defaults
+typedef struct huffman_decompress_options {
+    unsigned threads;         // Block container threads (0 or 1 = caller only)
+} huffman_decompress_options_t;
+
 // Context management
 huffman_context_t* huffman_context_create(void);
 void huffman_context_destroy(huffman_context_t* ctx);
@@ -25,12 +43,85 @@ int huffman_compress_file(const char* input_path, const char* output_path);
 int huffman_compress_data(const uint8_t* data, size_t data_size, 
                          uint8_t** compressed_data, size_t* compressed_size,
                          symbol_info_t** symbol_table, size_t* symbol_count);
+// Same codes, written as HUFFMAN_INTERLEAVE_STREAMS streams behind a jump table
+int huffman_compress_data_interleaved(const uint8_t* data, size_t data_size,
+                                     uint8_t** compressed_data, size_t* compressed_size,
+                                     symbol_info_t** symbol_table, size_t* symbol_count);
+
+// Same, with explicit settings (NULL = defaults). A code length limit below
+// the unlimited optimum costs a little ratio; codes that fit in the 12-bit
+// direct table always decode in a single table probe.
+int huffman_compress_file_with_options(const char* input_path, const char* output_path,
+                                       const huffman_compress_options_t* options);
+int huffman_compress_data_with_options(const uint8_t* data, size_t data_size,
+                                       const huffman_compress_options_t* options,
+                                       uint8_t** compressed_data, size_t* compressed_size,
+                                       symbol_info_t** symbol_table, size_t* symbol_count);
+int huffman_compress_data_interleaved_with_options(const uint8_t* data, size_t data_size,
+                                                   const huffman_compress_options_t* options,
+                                                   uint8_t** compressed_data, size_t* compressed_size,
+                                                   symbol_info_t** symbol_table, size_t* symbol_count);
+
+// Largest compressed data (either layout, before the header and symbol
+// table) any input of data_size bytes can produce; 0 if that overflows
+size_t huffman_compress_bound(size_t data_size);
+
+// Encode straight into the caller's buffer with no reallocation or copy.
+// Fails without writing if output_capacity is short of what the codes
+// need; huffman_compress_bound(data_size) is always enough.
+int huffman_compress_data_into(const uint8_t* data, size_t data_size,
+                               const huffman_compress_options_t* options,
+                               uint8_t* output, size_t output_capacity, size_t* compressed_size,
+                               symbol_info_t** symbol_table, size_t* symbol_count);
+int huffman_compress_data_interleaved_into(const uint8_t* data, size_t data_size,
+                                           const huffman_compress_options_t* options,
+                                           uint8_t* output, size_t output_capacity, size_t* compressed_size,
+                                           symbol_info_t** symbol_table, size_t* symbol_count);
+
+// Payload encoding for callers that build their own tables (the block
+// container): output space needed for these codes, including the encoder's
+// slack, and the encode itself, as one stream or interleaved streams
+// behind a jump table
+size_t huffman_payload_capacity(const code_table_t* code_table, const frequency_table_t* freq_table,
+                                int interleaved);
+int huffman_encode_payload(const code_table_t* code_table, const uint8_t* data, size_t data_size,
+                           int interleaved, uint8_t* output, size_t* compressed_size);
+
+// Streaming file compression and decompression: the block container one
+// block at a time, so memory stays constant for inputs of any size
+int huffman_compress_file_streaming(const char* input_path, const char* output_path,
+                                    const huffman_compress_options_t* options);
+int huffman_decompress_file_streaming(const char* input_path, const char* output_path);
+
+// Random access into a block container file: write original bytes
+// [start, end) to output, decoding only the blocks that overlap them, one
+// block at a time. end is clamped to the original size, so UINT64_MAX reads
+// to the end; start past it fails, as do version 1 files, which have no
+// index. Prints nothing, so output may be stdout.
+int huffman_decompress_file_range(const char* input_path, FILE* output, uint64_t start, uint64_t end);
 
 // File decompression  
 int huffman_decompress_file(const char* input_path, const char* output_path);
+// Same, with explicit settings (NULL = defaults)
+int huffman_decompress_file_with_options(const char* input_path, const char* output_path,
+                                         const huffman_decompress_options_t* options);
 int huffman_decompress_data(const uint8_t* compressed_data, size_t compressed_size,
                            const symbol_info_t* symbol_table, size_t symbol_count,
                            uint8_t** output_data, size_t* output_size, size_t expected_size);
+int huffman_decompress_data_interleaved(const uint8_t* compressed_data, size_t compressed_size,
+                                       const symbol_info_t* symbol_table, size_t symbol_count,
+                                       uint8_t** output_data, size_t* output_size, size_t expected_size);
+
+// Zero-allocation variants: decode exactly output_size bytes (the original
+// size) into the caller's buffer. Decoders come from the table cache and
+// bit streams live on the stack, so once a table is cached these never
+// touch the heap. 0 on success, -1 on invalid or truncated input.
+int huffman_decompress_data_into(const uint8_t* compressed_data, size_t compressed_size,
+                                 const symbol_info_t* symbol_table, size_t symbol_count,
+                                 uint8_t* output, size_t output_size);
+int huffman_decompress_data_interleaved_into(const uint8_t* compressed_data, size_t compressed_size,
+                                             const symbol_info_t* symbol_table, size_t symbol_count,
+                                             uint8_t* output, size_t output_size);
 
 // Utility functions
 void print_compression_stats(size_t original_size, size_t compressed_size);
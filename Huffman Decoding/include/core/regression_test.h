@@ -74,4 +74,10 @@ double calculate_suite_score(const regression_suite_t* suite);
 int validate_test_files(void);
 int generate_test_files_if_missing(void);
 
+// Correctness checks: round trips and edge cases on generated data, with no
+// timing and no test files. Prints each failure and returns how many checks
+// failed. allocation_count, when not NULL, returns the heap allocations made
+// so far and enables the checks that hot paths allocate nothing.
+int run_correctness_checks(size_t (*allocation_count)(void));
+
 #endif
\ No newline at end of file
@@ -19,13 +19,14 @@ void print_usage(const char* program_name) {
     printf("  -i, --iterations N    Number of iterations per test (default: 10)\n");
     printf("  -v, --verbose         Enable verbose output\n");
     printf("  -a, --all             Run all benchmark tests (default)\n");
-    printf("  -t, --test NAME       Run specific test (text|random|repetitive|binary|file)\n");
+    printf("  -t, --test NAME       Run specific test (text|random|repetitive|binary|histogram)\n");
     printf("  -f, --file PATH       Benchmark specific file\n");
     printf("  -h, --help            Show this help message\n\n");
     printf("Examples:\n");
     printf("  %s -i 20 -a           # Run all tests with 20 iterations\n", program_name);
     printf("  %s -t text -v         # Run only text test with verbose output\n", program_name);
     printf("  %s -f sample.txt      # Benchmark specific file\n", program_name);
+    printf("  %s -t histogram       # Frequency counting GB/s on the fixed tests\n", program_name);
 }
 
 uint8_t* read_file_for_benchmark(const char* filename, size_t* size) {
@@ -123,6 +124,30 @@ void run_synthetic_benchmarks(const benchmark_config_t* config) {
     }
 }
 
+// Histogramming is the first full pass over every input, so it gets its
+// own GB/s figures on the regression fixtures
+void run_histogram_benchmarks(const benchmark_config_t* config) {
+    const struct {
+        const char* name;
+        const char* filename;
+    } fixtures[] = {
+        { "LowEntropy8K", "fixed_tests/low_entropy_8k.dat" },
+        { "LargeText64K", "fixed_tests/large_text_64k.dat" },
+    };
+    
+    benchmark_print_histogram_header();
+    
+    for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+        size_t size;
+        uint8_t* data = read_file_for_benchmark(fixtures[i].filename, &size);
+        if (!data) continue;
+        
+        histogram_benchmark_t result = benchmark_histogram(fixtures[i].name, data, size, config->iterations);
+        benchmark_print_histogram_result(&result);
+        free(data);
+    }
+}
+
 void run_file_benchmark(const benchmark_config_t* config) {
     size_t file_size;
     uint8_t* file_data = read_file_for_benchmark(config->input_file, &file_size);
@@ -208,6 +233,14 @@ int main(int argc, char* argv[]) {
     // Print system information
     print_system_info();
     
+    if (config.specific_test && strcmp(config.specific_test, "histogram") == 0) {
+        run_histogram_benchmarks(&config);
+        printf("-----------------------------------------------------------------\n");
+        printf("Best of %d iterations per test\n", config.iterations);
+        printf("=================================================================\n\n");
+        return 0;
+    }
+    
     // Print benchmark header
     benchmark_print_header();
     
@@ -65,13 +65,15 @@ bit_stream_t* bit_stream_create(uint8_t* data, size_t size) {
     bit_stream_t* stream = malloc(sizeof(bit_stream_t));
     if (!stream) return NULL;
     
-    stream->data = data;
-    stream->data_size = size;
-    stream->byte_pos = 0;
-    stream->bit_pos = 0;
-    stream->bit_buffer = 0;
-    stream->bits_in_buffer = 0;
-    
+    bit_stream_init(stream, data, size, 0);
+    return stream;
+}
+
+bit_stream_t* bit_stream_create_padded(uint8_t* data, size_t size, size_t padding) {
+    bit_stream_t* stream = bit_stream_create(data, size);
+    if (stream) {
+        stream->readable_size = size + padding;
+    }
     return stream;
 }
 
@@ -82,7 +84,7 @@ void bit_stream_destroy(bit_stream_t* stream) {
 }
 
 // ITERATION 3: NEON SIMD optimized buffer filling with vectorized processing
-static void bit_stream_fill_buffer(bit_stream_t* stream) {
+void bit_stream_fill_buffer(bit_stream_t* stream) {
     // NEON SIMD optimization: Process multiple bytes with vectorized operations
     while (stream->bits_in_buffer < 32 && stream->byte_pos < stream->data_size) {
         size_t bytes_available = stream->data_size - stream->byte_pos;
@@ -190,35 +192,14 @@ bool bit_stream_read_bit(bit_stream_t* stream) {
 uint32_t bit_stream_read_bits(bit_stream_t* stream, uint8_t num_bits) {
     if (num_bits == 0 || num_bits > 32) return 0;
     
-    // ARM64 CLZ + Barrel Shifter optimization: Bulk bit extraction when possible
+    // ARM64 barrel shifter: bulk bit extraction straight from the buffer.
+    // Always consumes exactly num_bits, whatever the buffered bits hold.
     if (stream->bits_in_buffer >= num_bits) {
-        // Fast path: extract bits directly from buffer using CLZ and barrel shifter
-        // ARM64 barrel shifter makes these operations essentially free
+        uint32_t result = (uint32_t)(stream->bit_buffer >> (64 - num_bits));
         
-        // CLZ optimization: Use hardware CLZ for efficient bit extraction
-        int leading_zeros = arm64_clz64(stream->bit_buffer);
-        
-        // Use CLZ to optimize mask calculation and avoid expensive shifts
-        if (leading_zeros > 0 && leading_zeros < num_bits) {
-            // Buffer has leading zeros - optimize extraction pattern
-            uint8_t effective_shift = leading_zeros;
-            uint64_t optimized_mask = ((1ULL << num_bits) - 1) << (64 - num_bits + effective_shift);
-            uint32_t result = (uint32_t)((stream->bit_buffer & optimized_mask) >> (64 - num_bits + effective_shift));
-            
-            // Adjust buffer position based on CLZ analysis
-            stream->bit_buffer <<= (num_bits - effective_shift);
-            stream->bits_in_buffer -= (num_bits - effective_shift);
-            return result;
-        } else {
-            // Standard path when CLZ doesn't help
-            uint8_t effective_shift = 64 - num_bits;
-            uint64_t mask = ((1ULL << num_bits) - 1) << effective_shift;
-            uint32_t result = (uint32_t)((stream->bit_buffer & mask) >> effective_shift);
-            
-            stream->bit_buffer <<= num_bits;
-            stream->bits_in_buffer -= num_bits;
-            return result;
-        }
+        stream->bit_buffer <<= num_bits;
+        stream->bits_in_buffer -= num_bits;
+        return result;
     }
     
     // Slow path: need to refill buffer or read bits individually
@@ -273,6 +254,45 @@ int bit_stream_read_bits_batch(bit_stream_t* stream, uint8_t* bit_counts, uint32
 }
 #endif
 
+// Lookup table support: peek at the next bits without consuming them.
+// Past the end of the stream the missing low bits read as zero, so a table
+// probe near the tail still lands on the right entry; callers compare the
+// matched code length against bit_stream_available_bits().
+uint32_t bit_stream_peek_bits(bit_stream_t* stream, uint8_t num_bits) {
+    if (num_bits == 0 || num_bits > 32) return 0xFFFFFFFF;
+    
+    if (stream->bits_in_buffer < num_bits) {
+        bit_stream_fill_buffer(stream);
+    }
+    
+    return (uint32_t)(stream->bit_buffer >> (64 - num_bits));
+}
+
+// Lookup table support: consume bits after a successful table probe
+void bit_stream_skip_bits(bit_stream_t* stream, uint8_t num_bits) {
+    if (num_bits == 0 || num_bits > 32) return;
+    
+    if (stream->bits_in_buffer < num_bits) {
+        bit_stream_fill_buffer(stream);
+    }
+    
+    if (stream->bits_in_buffer >= num_bits) {
+        stream->bit_buffer <<= num_bits;
+        stream->bits_in_buffer -= num_bits;
+    } else {
+        // Skipping past the end drains the stream
+        stream->bit_buffer = 0;
+        stream->bits_in_buffer = 0;
+    }
+}
+
+int bit_stream_available_bits(bit_stream_t* stream) {
+    if (stream->bits_in_buffer < 32) {
+        bit_stream_fill_buffer(stream);
+    }
+    return stream->bits_in_buffer;
+}
+
 bool bit_stream_has_data(bit_stream_t* stream) {
     return stream->bits_in_buffer > 0 || stream->byte_pos < stream->data_size;
 }
\ No newline at end of file
@@ -41,6 +41,7 @@ bit_stream_t* bit_stream_create(uint8_t* data, size_t size) {
     stream->bit_pos = 0;
     stream->bit_buffer = 0;
     stream->bits_in_buffer = 0;
+    stream->readable_size = size;
     
     // ITERATION 4: Pre-fill buffer for immediate availability
     if (size > 0) {
@@ -50,6 +51,14 @@ bit_stream_t* bit_stream_create(uint8_t* data, size_t size) {
     return stream;
 }
 
+bit_stream_t* bit_stream_create_padded(uint8_t* data, size_t size, size_t padding) {
+    bit_stream_t* stream = bit_stream_create(data, size);
+    if (stream) {
+        stream->readable_size = size + padding;
+    }
+    return stream;
+}
+
 void bit_stream_destroy(bit_stream_t* stream) {
     if (stream) {
         free(stream);
@@ -62,7 +71,7 @@ void bit_stream_fill_buffer(bit_stream_t* stream) {
     while (stream->bits_in_buffer <= 56 && stream->byte_pos < stream->data_size) {
         size_t bytes_available = stream->data_size - stream->byte_pos;
         size_t bits_needed = 64 - stream->bits_in_buffer;
-        size_t bytes_to_read = (bits_needed + 7) >> 3;
+        size_t bytes_to_read = bits_needed >> 3;  // Whole bytes that fit in the buffer
         
         if (bytes_to_read > bytes_available) {
             bytes_to_read = bytes_available;
@@ -160,13 +169,10 @@ uint32_t bit_stream_peek_bits(bit_stream_t* stream, uint8_t num_bits) {
         bit_stream_fill_buffer(stream);
     }
     
-    if (stream->bits_in_buffer >= num_bits) {
-        // Return bits without consuming them
-        return (uint32_t)(stream->bit_buffer >> (64 - num_bits));
-    }
-    
-    // Not enough bits available
-    return 0xFFFFFFFF;
+    // Return bits without consuming them. Near the end of the stream the
+    // missing low bits read as zero; callers check the matched code length
+    // against bit_stream_available_bits().
+    return (uint32_t)(stream->bit_buffer >> (64 - num_bits));
 }
 
 // ITERATION 4: Skip bits after successful lookup
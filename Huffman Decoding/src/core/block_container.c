@@ -0,0 +1,916 @@
+#include "block_container.h"
+#include "encoder.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned clamp_threads(unsigned threads) {
+    if (threads <= 1) return 1;
+    return (threads < HUFFMAN_MAX_THREADS) ? threads : HUFFMAN_MAX_THREADS;
+}
+
+static unsigned options_threads(const huffman_compress_options_t* options) {
+    return clamp_threads(options ? options->threads : 0);
+}
+
+static size_t options_block_size(const huffman_compress_options_t* options) {
+    if (!options || options->block_size == 0) return HUFFMAN_DEFAULT_BLOCK_SIZE;
+    if (options->block_size < HUFFMAN_MIN_BLOCK_SIZE) return HUFFMAN_MIN_BLOCK_SIZE;
+    if (options->block_size > HUFFMAN_MAX_BLOCK_SIZE) return HUFFMAN_MAX_BLOCK_SIZE;
+    return options->block_size;
+}
+
+// Grow *buffer to hold at least `needed` bytes, doubling to keep appends
+// amortized
+static int reserve(uint8_t** buffer, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) return 0;
+    
+    size_t new_capacity = *capacity * 2;
+    if (new_capacity < needed) new_capacity = needed;
+    
+    uint8_t* grown = realloc(*buffer, new_capacity);
+    if (!grown) return -1;
+    
+    *buffer = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+// Append one block (header, table, payload) at *used. The table is written
+// before the payload is encoded, so the payload lands in place with no copy.
+static int append_block(const uint8_t* data, size_t length, uint8_t max_code_length,
+                        uint8_t** buffer, size_t* capacity, size_t* used, uint8_t* longest_code,
+                        uint32_t* checksum) {
+    frequency_table_t freq_table;
+    uint8_t code_lengths[MAX_SYMBOLS];
+    
+    if (frequency_table_analyze_checksum(&freq_table, data, length, checksum) != 0 ||
+        build_limited_code_lengths(&freq_table, max_code_length, code_lengths) != 0) {
+        return -1;
+    }
+    
+    code_table_t* code_table = code_table_from_lengths(code_lengths);
+    if (!code_table) return -1;
+    
+    // Lengths alone are enough for the canonical codes; keep the explicit
+    // table only where it is smaller (a few widely spread symbols) or a code
+    // is too long for a nibble
+    const int interleaved = length >= INTERLEAVE_MIN_INPUT;
+    const size_t packed_size = huffman_packed_lengths_size(code_lengths);
+    const int packed = packed_size > 0 && packed_size < freq_table.unique_symbols * sizeof(symbol_info_t);
+    const size_t table_size = packed ? packed_size : freq_table.unique_symbols * sizeof(symbol_info_t);
+    const size_t payload_capacity = huffman_payload_capacity(code_table, &freq_table, interleaved);
+    
+    if (reserve(buffer, capacity, *used + sizeof(huffman_block_header_t) + table_size + payload_capacity) != 0) {
+        code_table_destroy(code_table);
+        return -1;
+    }
+    
+    uint8_t* out = *buffer + *used + sizeof(huffman_block_header_t);
+    if (packed) {
+        out += huffman_pack_lengths(code_lengths, out);
+    } else {
+        for (int i = 0; i < MAX_SYMBOLS; i++) {
+            if (!code_table->codes[i].valid) continue;
+            
+            symbol_info_t info = {
+                .symbol = (uint8_t)i,
+                .code_length = code_table->codes[i].length,
+                .code = code_table->codes[i].code,
+            };
+            memcpy(out, &info, sizeof(info));
+            out += sizeof(info);
+        }
+    }
+    
+    size_t payload_size;
+    int result = huffman_encode_payload(code_table, data, length, interleaved, out, &payload_size);
+    if (code_table->max_length > *longest_code) {
+        *longest_code = code_table->max_length;
+    }
+    code_table_destroy(code_table);
+    if (result != 0 || payload_size > UINT32_MAX) return -1;
+    
+    huffman_block_header_t header = {
+        .original_size = (uint32_t)length,
+        .compressed_size = (uint32_t)payload_size,
+        .checksum = *checksum,
+        .symbol_count = (uint16_t)freq_table.unique_symbols,
+        .flags = (interleaved ? HUFFMAN_FLAG_INTERLEAVED : 0) | (packed ? HUFFMAN_BLOCK_FLAG_PACKED_LENGTHS : 0),
+    };
+    memcpy(*buffer + *used, &header, sizeof(header));
+    *used += sizeof(header) + table_size + payload_size;
+    return 0;
+}
+
+// A requested limit is recorded as is, as in version 1 files
+static huffman_header_t container_header(const huffman_compress_options_t* options, uint8_t longest_code,
+                                         uint64_t original_size, uint64_t compressed_size, uint32_t checksum) {
+    huffman_header_t header = {0};
+    header.magic = HUFFMAN_MAGIC;
+    header.version = HUFFMAN_VERSION;
+    header.original_size = original_size;
+    header.compressed_size = compressed_size;
+    header.symbol_count = 0;
+    header.max_code_length = (options && options->max_code_length) ? options->max_code_length : longest_code;
+    header.checksum = checksum;
+    return header;
+}
+
+// Run worker(arg) on the calling thread and up to threads - 1 helpers, no
+// more threads than jobs. A helper that fails to start just leaves more jobs
+// for the rest.
+static void run_workers(void* (*worker)(void*), void* arg, unsigned threads, size_t jobs) {
+    size_t helpers = (threads > 1) ? threads - 1 : 0;
+    if (helpers >= jobs) helpers = jobs ? jobs - 1 : 0;
+    
+    pthread_t* workers = helpers ? malloc(helpers * sizeof(pthread_t)) : NULL;
+    size_t started = 0;
+    while (workers && started < helpers && pthread_create(&workers[started], NULL, worker, arg) == 0) {
+        started++;
+    }
+    
+    worker(arg);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+}
+
+// Parallel encoding. Blocks are independent, so workers claim them from a
+// shared counter and encode each into its own buffer; laying the buffers
+// out in block order afterwards gives the same bytes for any thread count.
+typedef struct encoded_block {
+    uint8_t* data;            // Block header, table and payload
+    size_t capacity;
+    size_t size;
+    uint32_t checksum;        // CRC32 of the block's original data
+    uint8_t longest_code;
+    int failed;
+} encoded_block_t;
+
+typedef struct block_jobs {
+    const uint8_t* data;
+    size_t data_size;
+    size_t block_size;
+    uint8_t max_code_length;
+    encoded_block_t* blocks;
+    size_t block_count;
+    size_t next;              // First unclaimed block, under lock
+    pthread_mutex_t lock;
+} block_jobs_t;
+
+static void* encode_worker(void* arg) {
+    block_jobs_t* jobs = arg;
+    
+    for (;;) {
+        pthread_mutex_lock(&jobs->lock);
+        size_t b = jobs->next++;
+        pthread_mutex_unlock(&jobs->lock);
+        if (b >= jobs->block_count) return NULL;
+        
+        size_t start = b * jobs->block_size;
+        size_t length = (jobs->data_size - start < jobs->block_size) ? jobs->data_size - start : jobs->block_size;
+        
+        encoded_block_t* block = &jobs->blocks[b];
+        block->size = 0;
+        block->longest_code = 0;
+        block->failed = append_block(jobs->data + start, length, jobs->max_code_length, &block->data,
+                                     &block->capacity, &block->size, &block->longest_code,
+                                     &block->checksum) != 0;
+    }
+}
+
+// Encode the block_count blocks of data into blocks[] on up to `threads`
+// threads, the caller being one of them
+static int encode_blocks(const uint8_t* data, size_t data_size, size_t block_size, uint8_t max_code_length,
+                         unsigned threads, encoded_block_t* blocks, size_t block_count) {
+    block_jobs_t jobs = {
+        .data = data,
+        .data_size = data_size,
+        .block_size = block_size,
+        .max_code_length = max_code_length,
+        .blocks = blocks,
+        .block_count = block_count,
+        .next = 0,
+    };
+    if (pthread_mutex_init(&jobs.lock, NULL) != 0) return -1;
+    
+    run_workers(encode_worker, &jobs, threads, block_count);
+    pthread_mutex_destroy(&jobs.lock);
+    
+    for (size_t b = 0; b < block_count; b++) {
+        if (blocks[b].failed) return -1;
+    }
+    return 0;
+}
+
+// Parallel counterpart of the append_block loop in huffman_compress_blocks
+static int append_blocks_parallel(const uint8_t* data, size_t data_size, size_t block_size,
+                                  uint8_t max_code_length, unsigned threads, size_t block_count,
+                                  huffman_index_entry_t* entries, uint8_t** buffer, size_t* capacity,
+                                  size_t* used, uint8_t* longest_code, uint32_t* checksum) {
+    encoded_block_t* blocks = calloc(block_count, sizeof(encoded_block_t));
+    if (!blocks) return -1;
+    
+    int result = encode_blocks(data, data_size, block_size, max_code_length, threads, blocks, block_count);
+    
+    size_t total = *used;
+    for (size_t b = 0; result == 0 && b < block_count; b++) {
+        total += blocks[b].size;
+    }
+    if (result == 0) result = reserve(buffer, capacity, total);
+    
+    for (size_t b = 0; b < block_count; b++) {
+        if (result == 0) {
+            size_t start = b * block_size;
+            size_t length = (data_size - start < block_size) ? data_size - start : block_size;
+            
+            entries[b].original_offset = start;
+            entries[b].block_offset = *used;
+            memcpy(*buffer + *used, blocks[b].data, blocks[b].size);
+            *used += blocks[b].size;
+            
+            if (blocks[b].longest_code > *longest_code) *longest_code = blocks[b].longest_code;
+            *checksum = calculate_crc32_combine(*checksum, blocks[b].checksum, length);
+        }
+        free(blocks[b].data);
+    }
+    free(blocks);
+    return result;
+}
+
+int huffman_compress_blocks(const uint8_t* data, size_t data_size,
+                            const huffman_compress_options_t* options,
+                            uint8_t** output, size_t* output_size) {
+    if (!output || !output_size || (!data && data_size > 0)) return -1;
+    
+    const size_t block_size = options_block_size(options);
+    const size_t block_count = (data_size + block_size - 1) / block_size;
+    const uint8_t max_code_length = (options && options->max_code_length) ? options->max_code_length
+                                                                          : MAX_CODE_LENGTH;
+    if (block_count > UINT32_MAX) return -1;
+    
+    huffman_index_entry_t* entries = malloc((block_count ? block_count : 1) * sizeof(huffman_index_entry_t));
+    size_t capacity = sizeof(huffman_header_t) + data_size / 2 + 4096;
+    uint8_t* buffer = malloc(capacity);
+    if (!entries || !buffer) {
+        free(entries);
+        free(buffer);
+        return -1;
+    }
+    
+    size_t used = sizeof(huffman_header_t);
+    uint8_t longest_code = 0;
+    uint32_t checksum = 0;  // CRC32 of no data
+    
+    const unsigned threads = options_threads(options);
+    if (threads > 1 && block_count > 1) {
+        if (append_blocks_parallel(data, data_size, block_size, max_code_length, threads, block_count, entries,
+                                   &buffer, &capacity, &used, &longest_code, &checksum) != 0) {
+            free(entries);
+            free(buffer);
+            return -1;
+        }
+    } else {
+        for (size_t b = 0; b < block_count; b++) {
+            size_t start = b * block_size;
+            size_t length = (data_size - start < block_size) ? data_size - start : block_size;
+            
+            entries[b].original_offset = start;
+            entries[b].block_offset = used;
+            uint32_t block_checksum;
+            if (append_block(data + start, length, max_code_length, &buffer, &capacity, &used, &longest_code,
+                             &block_checksum) != 0) {
+                free(entries);
+                free(buffer);
+                return -1;
+            }
+            
+            // The file CRC comes from the block CRCs, not another pass over data
+            checksum = calculate_crc32_combine(checksum, block_checksum, length);
+        }
+    }
+    
+    const size_t index_size = block_count * sizeof(huffman_index_entry_t);
+    if (reserve(&buffer, &capacity, used + index_size + sizeof(huffman_index_trailer_t)) != 0) {
+        free(entries);
+        free(buffer);
+        return -1;
+    }
+    
+    memcpy(buffer + used, entries, index_size);
+    used += index_size;
+    free(entries);
+    
+    huffman_index_trailer_t trailer = {
+        .original_size = data_size,
+        .block_count = (uint32_t)block_count,
+        .block_size = (uint32_t)block_size,
+        .checksum = checksum,
+        .magic = HUFFMAN_INDEX_MAGIC,
+    };
+    memcpy(buffer + used, &trailer, sizeof(trailer));
+    used += sizeof(trailer);
+    
+    huffman_header_t header = container_header(options, longest_code, data_size,
+                                               used - sizeof(huffman_header_t), checksum);
+    memcpy(buffer, &header, sizeof(header));
+    
+    // Give back the worst-case slack reserved for the last block
+    uint8_t* trimmed = realloc(buffer, used);
+    *output = trimmed ? trimmed : buffer;
+    *output_size = used;
+    return 0;
+}
+
+int huffman_read_block_index(const uint8_t* input, size_t input_size, huffman_block_index_t* index) {
+    if (!input || !index) return -1;
+    if (input_size < sizeof(huffman_header_t) + sizeof(huffman_index_trailer_t)) return -1;
+    
+    memcpy(&index->header, input, sizeof(huffman_header_t));
+    memcpy(&index->trailer, input + input_size - sizeof(huffman_index_trailer_t), sizeof(huffman_index_trailer_t));
+    
+    huffman_header_t* header = &index->header;
+    const huffman_index_trailer_t* trailer = &index->trailer;
+    const int streamed = (header->flags & HUFFMAN_FLAG_STREAMED) != 0;
+    if (header->magic != HUFFMAN_MAGIC || header->version != HUFFMAN_VERSION ||
+        (header->flags & ~HUFFMAN_KNOWN_FLAGS) || header->symbol_count != 0) {
+        return -1;
+    }
+    
+    // A streamed header holds no totals; take them from the trailer
+    if (streamed) {
+        if (header->original_size != 0 || header->compressed_size != 0 || header->checksum != 0) return -1;
+        header->original_size = trailer->original_size;
+        header->compressed_size = input_size - sizeof(huffman_header_t);
+        header->checksum = trailer->checksum;
+    }
+    if (header->compressed_size != input_size - sizeof(huffman_header_t)) return -1;
+    if (trailer->magic != HUFFMAN_INDEX_MAGIC || trailer->original_size != header->original_size ||
+        trailer->checksum != header->checksum ||
+        trailer->block_size < HUFFMAN_MIN_BLOCK_SIZE || trailer->block_size > HUFFMAN_MAX_BLOCK_SIZE) {
+        return -1;
+    }
+    
+    const uint64_t blocks = trailer->block_count;
+    if (header->original_size > UINT64_MAX - trailer->block_size) return -1;
+    if (blocks != (header->original_size + trailer->block_size - 1) / trailer->block_size) return -1;
+    
+    const size_t end_marker = streamed ? sizeof(huffman_block_header_t) : 0;
+    const size_t room = input_size - sizeof(huffman_header_t) - sizeof(huffman_index_trailer_t) - end_marker;
+    if (input_size < sizeof(huffman_header_t) + sizeof(huffman_index_trailer_t) + end_marker ||
+        blocks > room / sizeof(huffman_index_entry_t)) {
+        return -1;
+    }
+    
+    index->index_offset = input_size - sizeof(huffman_index_trailer_t) - blocks * sizeof(huffman_index_entry_t);
+    index->entries = (const huffman_index_entry_t*)(input + index->index_offset);
+    index->blocks_end = index->index_offset - end_marker;
+    
+    if (streamed) {
+        static const huffman_block_header_t end = {0};
+        if (memcmp(input + index->blocks_end, &end, sizeof(end)) != 0) return -1;
+    }
+    
+    // Blocks cover the input in order at block_size steps and sit between
+    // the header and the index, each after the one before
+    uint64_t previous_end = sizeof(huffman_header_t);
+    for (uint64_t b = 0; b < blocks; b++) {
+        const huffman_index_entry_t* entry = &index->entries[b];
+        if (entry->original_offset != b * trailer->block_size || entry->block_offset < previous_end ||
+            entry->block_offset > index->blocks_end - sizeof(huffman_block_header_t)) {
+            return -1;
+        }
+        previous_end = entry->block_offset + sizeof(huffman_block_header_t);
+    }
+    
+    return 0;
+}
+
+// Decode one block held in span bytes at block (at least its header), checking
+// its table against max_code_length and its CRC
+static int decode_block_span(const uint8_t* block, uint64_t span, uint16_t max_code_length,
+                             uint8_t* output, size_t output_size) {
+    huffman_block_header_t header;
+    memcpy(&header, block, sizeof(header));
+    
+    if (header.original_size != output_size || header.symbol_count == 0 || header.symbol_count > MAX_SYMBOLS ||
+        (header.flags & ~HUFFMAN_BLOCK_KNOWN_FLAGS)) {
+        return -1;
+    }
+    
+    // Either table form becomes an explicit canonical table for the decoder
+    const uint8_t* table = block + sizeof(header);
+    symbol_info_t unpacked[MAX_SYMBOLS];
+    const symbol_info_t* symbol_table = unpacked;
+    uint64_t table_size;
+    if (header.flags & HUFFMAN_BLOCK_FLAG_PACKED_LENGTHS) {
+        uint8_t code_lengths[MAX_SYMBOLS];
+        size_t packed_size;
+        if (huffman_unpack_lengths(table, span - sizeof(header), code_lengths, &packed_size) != 0 ||
+            huffman_symbols_from_lengths(code_lengths, unpacked) != header.symbol_count) {
+            return -1;
+        }
+        table_size = packed_size;
+    } else {
+        symbol_table = (const symbol_info_t*)table;
+        table_size = (uint64_t)header.symbol_count * sizeof(symbol_info_t);
+    }
+    
+    const uint64_t payload_offset = sizeof(header) + table_size;
+    if (payload_offset + header.compressed_size > span) return -1;
+    
+    for (size_t i = 0; i < header.symbol_count; i++) {
+        if (symbol_table[i].code_length > max_code_length) return -1;
+    }
+    
+    const uint8_t* payload = block + payload_offset;
+    int result;
+    if (header.flags & HUFFMAN_FLAG_INTERLEAVED) {
+        result = huffman_decompress_data_interleaved_into(payload, header.compressed_size, symbol_table,
+                                                          header.symbol_count, output, output_size);
+    } else {
+        result = huffman_decompress_data_into(payload, header.compressed_size, symbol_table,
+                                              header.symbol_count, output, output_size);
+    }
+    
+    if (result != 0 || calculate_crc32(output, output_size) != header.checksum) return -1;
+    return 0;
+}
+
+int huffman_decode_block(const uint8_t* input, const huffman_block_index_t* index, size_t block,
+                         uint8_t* output, size_t output_size) {
+    if (!input || !index || block >= index->trailer.block_count) return -1;
+    
+    const huffman_index_entry_t* entry = &index->entries[block];
+    const uint64_t block_end = (block + 1 < index->trailer.block_count) ? index->entries[block + 1].block_offset
+                                                                        : index->blocks_end;
+    const uint64_t expected_size = index->header.original_size - entry->original_offset;
+    if (output_size != (expected_size < index->trailer.block_size ? expected_size : index->trailer.block_size)) {
+        return -1;
+    }
+    
+    return decode_block_span(input + entry->block_offset, block_end - entry->block_offset,
+                             index->header.max_code_length, output, output_size);
+}
+
+// Block b's span of the original data
+static uint64_t block_length(const huffman_block_index_t* index, size_t b) {
+    uint64_t length = index->header.original_size - index->entries[b].original_offset;
+    return (length < index->trailer.block_size) ? length : index->trailer.block_size;
+}
+
+// Parallel decoding. Output regions are disjoint, so workers claim blocks
+// from a shared counter and decode each in place; after a failure the
+// remaining blocks are left alone.
+typedef struct decode_jobs {
+    const uint8_t* input;
+    const huffman_block_index_t* index;
+    uint8_t* output;
+    size_t next;              // First unclaimed block, under lock
+    int failed;               // Under lock
+    pthread_mutex_t lock;
+} decode_jobs_t;
+
+static void* decode_worker(void* arg) {
+    decode_jobs_t* jobs = arg;
+    const huffman_block_index_t* index = jobs->index;
+    
+    for (;;) {
+        pthread_mutex_lock(&jobs->lock);
+        size_t b = jobs->failed ? index->trailer.block_count : jobs->next++;
+        pthread_mutex_unlock(&jobs->lock);
+        if (b >= index->trailer.block_count) return NULL;
+        
+        if (huffman_decode_block(jobs->input, index, b, jobs->output + index->entries[b].original_offset,
+                                 block_length(index, b)) != 0) {
+            pthread_mutex_lock(&jobs->lock);
+            jobs->failed = 1;
+            pthread_mutex_unlock(&jobs->lock);
+        }
+    }
+}
+
+int huffman_decode_blocks(const uint8_t* input, const huffman_block_index_t* index, unsigned threads,
+                          uint8_t* output) {
+    if (!input || !index || (!output && index->header.original_size > 0)) return -1;
+    
+    const size_t block_count = index->trailer.block_count;
+    threads = clamp_threads(threads);
+    
+    // Each block's CRC is checked while its output is still in cache
+    if (threads > 1 && block_count > 1) {
+        decode_jobs_t jobs = {
+            .input = input,
+            .index = index,
+            .output = output,
+            .next = 0,
+            .failed = 0,
+        };
+        if (pthread_mutex_init(&jobs.lock, NULL) != 0) return -1;
+        
+        run_workers(decode_worker, &jobs, threads, block_count);
+        pthread_mutex_destroy(&jobs.lock);
+        if (jobs.failed) return -1;
+    } else {
+        for (size_t b = 0; b < block_count; b++) {
+            if (huffman_decode_block(input, index, b, output + index->entries[b].original_offset,
+                                     block_length(index, b)) != 0) {
+                return -1;
+            }
+        }
+    }
+    
+    // The file CRC is assembled from the checked block CRCs, in block order,
+    // instead of re-reading the output
+    uint32_t checksum = 0;
+    for (size_t b = 0; b < block_count; b++) {
+        huffman_block_header_t header;
+        memcpy(&header, input + index->entries[b].block_offset, sizeof(header));
+        checksum = calculate_crc32_combine(checksum, header.checksum, block_length(index, b));
+    }
+    
+    return (checksum == index->header.checksum) ? 0 : -1;
+}
+
+int huffman_decode_range(const uint8_t* input, const huffman_block_index_t* index,
+                         uint64_t start, uint64_t end, uint8_t* output) {
+    if (!input || !index || start > end || end > index->header.original_size || (!output && end > start)) {
+        return -1;
+    }
+    
+    // Blocks wholly inside the range decode in place; the one or two cut by
+    // its ends decode into scratch and contribute only their overlap
+    const uint64_t block_size = index->trailer.block_size;
+    uint8_t* scratch = NULL;
+    int result = 0;
+    for (size_t b = start / block_size; result == 0 && b * block_size < end; b++) {
+        const uint64_t block_start = index->entries[b].original_offset;
+        const uint64_t length = block_length(index, b);
+        const uint64_t from = (start > block_start) ? start - block_start : 0;
+        const uint64_t to = (end < block_start + length) ? end - block_start : length;
+        uint8_t* target = output + (block_start + from - start);
+        
+        if (from == 0 && to == length) {
+            result = huffman_decode_block(input, index, b, target, length);
+        } else if (!scratch && !(scratch = malloc(block_size))) {
+            result = -1;
+        } else if ((result = huffman_decode_block(input, index, b, scratch, length)) == 0) {
+            memcpy(target, scratch + from, to - from);
+        }
+    }
+    
+    free(scratch);
+    return result;
+}
+
+int huffman_decompress_blocks(const uint8_t* input, size_t input_size,
+                              const huffman_decompress_options_t* options,
+                              uint8_t** output, size_t* output_size) {
+    if (!output || !output_size) return -1;
+    
+    huffman_block_index_t index;
+    if (huffman_read_block_index(input, input_size, &index) != 0) return -1;
+    
+    const uint64_t original_size = index.header.original_size;
+    if (original_size > SIZE_MAX - 1) return -1;
+    
+    uint8_t* data = malloc(original_size ? original_size : 1);
+    if (!data) return -1;
+    
+    if (huffman_decode_blocks(input, &index, options ? options->threads : 0, data) != 0) {
+        free(data);
+        return -1;
+    }
+    
+    *output = data;
+    *output_size = original_size;
+    return 0;
+}
+
+// The kernel's read-ahead then overlaps reading the next block with
+// encoding or decoding this one
+static void advise_sequential(FILE* file) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    (void)file;
+#endif
+}
+
+// Grow an index entry array by doubling
+static int reserve_entries(huffman_index_entry_t** entries, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) return 0;
+    
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed) new_capacity *= 2;
+    huffman_index_entry_t* grown = realloc(*entries, new_capacity * sizeof(huffman_index_entry_t));
+    if (!grown) return -1;
+    
+    *entries = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+// Buffers a stream owns: a batch of input (one block per thread), the
+// encoded blocks or one decoded block, and the index entries so far
+typedef struct stream_buffers {
+    uint8_t* data;
+    size_t data_capacity;
+    uint8_t* block;
+    size_t block_capacity;
+    encoded_block_t* encoded;
+    size_t encoded_count;
+    huffman_index_entry_t* entries;
+    size_t entry_count;
+    size_t entry_capacity;
+} stream_buffers_t;
+
+static void stream_buffers_free(stream_buffers_t* buffers) {
+    free(buffers->data);
+    free(buffers->block);
+    for (size_t i = 0; i < buffers->encoded_count; i++) {
+        free(buffers->encoded[i].data);
+    }
+    free(buffers->encoded);
+    free(buffers->entries);
+}
+
+static int compress_stream_blocks(FILE* input, FILE* output, const huffman_compress_options_t* options,
+                                  stream_buffers_t* buffers, uint64_t* original_size, uint64_t* compressed_size) {
+    const size_t block_size = options_block_size(options);
+    const uint8_t max_code_length = (options && options->max_code_length) ? options->max_code_length
+                                                                          : MAX_CODE_LENGTH;
+    
+    // Index offsets are relative to where the container starts. Without a
+    // way back to the header, the totals can only go in the trailer.
+    const long start = ftell(output);
+    const int seekable = start >= 0 && fseek(output, start, SEEK_SET) == 0;
+    
+    huffman_header_t header = container_header(options, max_code_length, 0, 0, 0);
+    if (!seekable) header.flags |= HUFFMAN_FLAG_STREAMED;
+    if (fwrite(&header, sizeof(header), 1, output) != 1) return -1;
+    
+    // Input is read a batch of one block per thread at a time; batches are
+    // whole blocks until EOF, so the blocks match the in-memory split
+    const unsigned threads = options_threads(options);
+    const size_t batch_size = threads * block_size;
+    buffers->encoded = calloc(threads, sizeof(encoded_block_t));
+    if (!buffers->encoded || reserve(&buffers->data, &buffers->data_capacity, batch_size) != 0) return -1;
+    buffers->encoded_count = threads;
+    
+    uint64_t total = 0;
+    uint64_t position = sizeof(huffman_header_t);
+    uint8_t longest_code = 0;
+    uint32_t checksum = 0;
+    
+    for (;;) {
+        size_t length = fread(buffers->data, 1, batch_size, input);
+        if (length == 0) break;
+        
+        const size_t count = (length + block_size - 1) / block_size;
+        if (reserve_entries(&buffers->entries, &buffers->entry_capacity, buffers->entry_count + count) != 0 ||
+            encode_blocks(buffers->data, length, block_size, max_code_length, threads,
+                          buffers->encoded, count) != 0) {
+            return -1;
+        }
+        
+        for (size_t b = 0; b < count; b++) {
+            const encoded_block_t* block = &buffers->encoded[b];
+            const size_t block_length = (length - b * block_size < block_size) ? length - b * block_size
+                                                                                : block_size;
+            if (fwrite(block->data, 1, block->size, output) != block->size) return -1;
+            
+            buffers->entries[buffers->entry_count].original_offset = total;
+            buffers->entries[buffers->entry_count].block_offset = position;
+            buffers->entry_count++;
+            
+            if (block->longest_code > longest_code) longest_code = block->longest_code;
+            checksum = calculate_crc32_combine(checksum, block->checksum, block_length);
+            total += block_length;
+            position += block->size;
+        }
+    }
+    if (ferror(input) || buffers->entry_count > UINT32_MAX) return -1;
+    
+    if (!seekable) {
+        static const huffman_block_header_t end = {0};
+        if (fwrite(&end, sizeof(end), 1, output) != 1) return -1;
+        position += sizeof(end);
+    }
+    
+    huffman_index_trailer_t trailer = {
+        .original_size = total,
+        .block_count = (uint32_t)buffers->entry_count,
+        .block_size = (uint32_t)block_size,
+        .checksum = checksum,
+        .magic = HUFFMAN_INDEX_MAGIC,
+    };
+    if ((buffers->entry_count > 0 &&
+         fwrite(buffers->entries, sizeof(huffman_index_entry_t), buffers->entry_count, output) != buffers->entry_count) ||
+        fwrite(&trailer, sizeof(trailer), 1, output) != 1) {
+        return -1;
+    }
+    position += buffers->entry_count * sizeof(huffman_index_entry_t) + sizeof(trailer);
+    
+    if (seekable) {
+        header = container_header(options, longest_code, total, position - sizeof(huffman_header_t), checksum);
+        if (fseek(output, start, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, output) != 1 ||
+            fseek(output, 0, SEEK_END) != 0) {
+            return -1;
+        }
+    }
+    if (fflush(output) != 0) return -1;
+    
+    if (original_size) *original_size = total;
+    if (compressed_size) *compressed_size = position;
+    return 0;
+}
+
+int huffman_compress_stream(FILE* input, FILE* output, const huffman_compress_options_t* options,
+                            uint64_t* original_size, uint64_t* compressed_size) {
+    if (!input || !output) return -1;
+    
+    advise_sequential(input);
+    
+    stream_buffers_t buffers = {0};
+    int result = compress_stream_blocks(input, output, options, &buffers, original_size, compressed_size);
+    stream_buffers_free(&buffers);
+    return result;
+}
+
+// Version 1: one table and one bit stream, decoded in one piece
+static int decompress_stream_single(FILE* input, FILE* output, const huffman_header_t* header,
+                                    stream_buffers_t* buffers, uint64_t* original_size) {
+    symbol_info_t symbol_table[MAX_SYMBOLS];
+    if (header->symbol_count == 0 || header->symbol_count > MAX_SYMBOLS ||
+        header->original_size > SIZE_MAX || header->compressed_size > SIZE_MAX ||
+        huffman_read_symbol_table(input, symbol_table, header->symbol_count) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < header->symbol_count; i++) {
+        if (symbol_table[i].code_length > header->max_code_length) return -1;
+    }
+    
+    const size_t compressed = (size_t)header->compressed_size;
+    const size_t length = (size_t)header->original_size;
+    if (reserve(&buffers->block, &buffers->block_capacity, compressed) != 0 ||
+        reserve(&buffers->data, &buffers->data_capacity, length) != 0 ||
+        fread(buffers->block, 1, compressed, input) != compressed) {
+        return -1;
+    }
+    
+    int result;
+    if (header->flags & HUFFMAN_FLAG_INTERLEAVED) {
+        result = huffman_decompress_data_interleaved_into(buffers->block, compressed, symbol_table,
+                                                          header->symbol_count, buffers->data, length);
+    } else {
+        result = huffman_decompress_data_into(buffers->block, compressed, symbol_table,
+                                              header->symbol_count, buffers->data, length);
+    }
+    if (result != 0 || calculate_crc32(buffers->data, length) != header->checksum ||
+        fwrite(buffers->data, 1, length, output) != length || fflush(output) != 0) {
+        return -1;
+    }
+    
+    if (original_size) *original_size = length;
+    return 0;
+}
+
+// Read one block (header, table, payload) into buffers->block; *span is its
+// size. *span is 0 at a streamed container's end marker.
+static int read_stream_block(FILE* input, int streamed, stream_buffers_t* buffers, size_t* span) {
+    huffman_block_header_t header;
+    if (fread(&header, sizeof(header), 1, input) != 1) return -1;
+    
+    static const huffman_block_header_t end = {0};
+    if (streamed && memcmp(&header, &end, sizeof(end)) == 0) {
+        *span = 0;
+        return 0;
+    }
+    
+    // Sizes are bounded before anything is allocated for them
+    if (header.original_size == 0 || header.original_size > HUFFMAN_MAX_BLOCK_SIZE ||
+        header.symbol_count == 0 || header.symbol_count > MAX_SYMBOLS ||
+        header.compressed_size > huffman_compress_bound(header.original_size)) {
+        return -1;
+    }
+    
+    // Room for either table form, whichever the flags turn out to use
+    size_t table_size = header.symbol_count * sizeof(symbol_info_t);
+    const size_t packed_most = 2 + MAX_SYMBOLS / 2;
+    const size_t most = sizeof(header) + (table_size > packed_most ? table_size : packed_most) +
+                        header.compressed_size;
+    if (reserve(&buffers->block, &buffers->block_capacity, most) != 0) return -1;
+    memcpy(buffers->block, &header, sizeof(header));
+    
+    uint8_t* table = buffers->block + sizeof(header);
+    if (header.flags & HUFFMAN_BLOCK_FLAG_PACKED_LENGTHS) {
+        // The symbol range in the first two bytes gives the table's size
+        if (fread(table, 1, 2, input) != 2 || table[0] > table[1]) return -1;
+        
+        table_size = 2 + (size_t)(table[1] - table[0] + 2) / 2;
+        if (fread(table + 2, 1, table_size - 2, input) != table_size - 2) return -1;
+    } else if (fread(table, 1, table_size, input) != table_size) {
+        return -1;
+    }
+    
+    if (fread(table + table_size, 1, header.compressed_size, input) != header.compressed_size) return -1;
+    
+    *span = sizeof(header) + table_size + header.compressed_size;
+    return 0;
+}
+
+static int decompress_stream_blocks(FILE* input, FILE* output, stream_buffers_t* buffers,
+                                    uint64_t* original_size) {
+    huffman_header_t header;
+    if (huffman_read_header(input, &header) != 0) return -1;
+    if (header.version == HUFFMAN_VERSION_SINGLE) {
+        return decompress_stream_single(input, output, &header, buffers, original_size);
+    }
+    
+    const int streamed = (header.flags & HUFFMAN_FLAG_STREAMED) != 0;
+    if (header.symbol_count != 0 ||
+        (streamed && (header.original_size != 0 || header.compressed_size != 0 || header.checksum != 0))) {
+        return -1;
+    }
+    
+    uint64_t total = 0;
+    uint64_t position = sizeof(huffman_header_t);
+    uint32_t checksum = 0;
+    
+    // Blocks until the end marker, or until the header's size is reached
+    while (streamed || total < header.original_size) {
+        size_t span;
+        if (read_stream_block(input, streamed, buffers, &span) != 0) return -1;
+        if (span == 0) {
+            position += sizeof(huffman_block_header_t);
+            break;
+        }
+        
+        huffman_block_header_t block;
+        memcpy(&block, buffers->block, sizeof(block));
+        if (!streamed && block.original_size > header.original_size - total) return -1;
+        
+        if (reserve(&buffers->data, &buffers->data_capacity, block.original_size) != 0 ||
+            reserve_entries(&buffers->entries, &buffers->entry_capacity, buffers->entry_count + 1) != 0 ||
+            decode_block_span(buffers->block, span, header.max_code_length,
+                              buffers->data, block.original_size) != 0 ||
+            fwrite(buffers->data, 1, block.original_size, output) != block.original_size) {
+            return -1;
+        }
+        
+        // Where the index must say this block is
+        buffers->entries[buffers->entry_count].original_offset = total;
+        buffers->entries[buffers->entry_count].block_offset = position;
+        buffers->entry_count++;
+        
+        checksum = calculate_crc32_combine(checksum, block.checksum, block.original_size);
+        total += block.original_size;
+        position += span;
+    }
+    
+    // The index and trailer must describe exactly the blocks just decoded
+    for (size_t b = 0; b < buffers->entry_count; b++) {
+        huffman_index_entry_t entry;
+        if (fread(&entry, sizeof(entry), 1, input) != 1 ||
+            memcmp(&entry, &buffers->entries[b], sizeof(entry)) != 0) {
+            return -1;
+        }
+    }
+    
+    huffman_index_trailer_t trailer;
+    if (fread(&trailer, sizeof(trailer), 1, input) != 1) return -1;
+    position += buffers->entry_count * sizeof(huffman_index_entry_t) + sizeof(trailer);
+    
+    if (trailer.magic != HUFFMAN_INDEX_MAGIC || trailer.block_count != buffers->entry_count ||
+        trailer.original_size != total || trailer.checksum != checksum ||
+        trailer.block_size < HUFFMAN_MIN_BLOCK_SIZE || trailer.block_size > HUFFMAN_MAX_BLOCK_SIZE ||
+        buffers->entry_count != (total + trailer.block_size - 1) / trailer.block_size) {
+        return -1;
+    }
+    for (size_t b = 0; b < buffers->entry_count; b++) {
+        if (buffers->entries[b].original_offset != b * (uint64_t)trailer.block_size) return -1;
+    }
+    if (!streamed && (header.checksum != checksum ||
+                      header.compressed_size != position - sizeof(huffman_header_t))) {
+        return -1;
+    }
+    if (fflush(output) != 0) return -1;
+    
+    if (original_size) *original_size = total;
+    return 0;
+}
+
+int huffman_decompress_stream(FILE* input, FILE* output, uint64_t* original_size) {
+    if (!input || !output) return -1;
+    
+    advise_sequential(input);
+    
+    stream_buffers_t buffers = {0};
+    int result = decompress_stream_blocks(input, output, &buffers, original_size);
+    stream_buffers_free(&buffers);
+    return result;
+}
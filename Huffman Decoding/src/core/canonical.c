@@ -0,0 +1,108 @@
+#include "canonical.h"
+#include <string.h>
+
+// Count codes per length and reject lengths that cannot form a prefix code
+static int count_lengths(const uint8_t* code_lengths, uint32_t* length_count) {
+    memset(length_count, 0, sizeof(uint32_t) * (CANONICAL_MAX_LENGTH + 1));
+    
+    for (int symbol = 0; symbol < CANONICAL_MAX_SYMBOLS; symbol++) {
+        if (code_lengths[symbol] > CANONICAL_MAX_LENGTH) return -1;
+        length_count[code_lengths[symbol]]++;
+    }
+    length_count[0] = 0;
+    
+    // Kraft inequality: each length may use at most the codes still free
+    uint64_t available = 1;
+    for (int length = 1; length <= CANONICAL_MAX_LENGTH; length++) {
+        available <<= 1;
+        if (length_count[length] > available) return -1;
+        available -= length_count[length];
+    }
+    
+    return 0;
+}
+
+int canonical_codes_from_lengths(const uint8_t* code_lengths, uint32_t* codes) {
+    if (!code_lengths || !codes) return -1;
+    
+    uint32_t length_count[CANONICAL_MAX_LENGTH + 1];
+    if (count_lengths(code_lengths, length_count) != 0) return -1;
+    
+    // First code of each length: the previous length's codes, shifted left
+    uint32_t next_code[CANONICAL_MAX_LENGTH + 1];
+    uint64_t code = 0;
+    next_code[0] = 0;
+    for (int length = 1; length <= CANONICAL_MAX_LENGTH; length++) {
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = (uint32_t)code;
+    }
+    
+    // Within a length, codes go to symbols in increasing symbol order
+    for (int symbol = 0; symbol < CANONICAL_MAX_SYMBOLS; symbol++) {
+        uint8_t length = code_lengths[symbol];
+        codes[symbol] = length ? next_code[length]++ : 0;
+    }
+    
+    return 0;
+}
+
+int canonical_decoder_build(canonical_decoder_t* decoder, const uint8_t* code_lengths) {
+    if (!decoder || !code_lengths) return -1;
+    
+    uint32_t length_count[CANONICAL_MAX_LENGTH + 1];
+    if (count_lengths(code_lengths, length_count) != 0) return -1;
+    
+    memset(decoder, 0, sizeof(*decoder));
+    
+    uint64_t code = 0;
+    uint32_t index = 0;
+    for (int length = 1; length <= CANONICAL_MAX_LENGTH; length++) {
+        code = (code + length_count[length - 1]) << 1;
+        
+        decoder->first_code[length] = (uint32_t)code;
+        decoder->offset[length] = (uint16_t)index;
+        decoder->limit[length] = (code + length_count[length]) << (CANONICAL_MAX_LENGTH - length);
+        index += length_count[length];
+        
+        if (length_count[length] > 0) {
+            if (decoder->min_length == 0) decoder->min_length = length;
+            decoder->max_length = length;
+        }
+    }
+    
+    if (decoder->max_length == 0) return -1;
+    
+    // Sort symbols by (length, symbol)
+    uint16_t next_index[CANONICAL_MAX_LENGTH + 1];
+    memcpy(next_index, decoder->offset, sizeof(next_index));
+    for (int symbol = 0; symbol < CANONICAL_MAX_SYMBOLS; symbol++) {
+        uint8_t length = code_lengths[symbol];
+        if (length) {
+            decoder->symbols[next_index[length]++] = (uint8_t)symbol;
+        }
+    }
+    
+    return 0;
+}
+
+// Decode one symbol by comparing a left-justified 32-bit peek against the
+// per-length limits; no tree and no table beyond the decoder itself.
+int canonical_decode_symbol(const canonical_decoder_t* decoder, bit_stream_t* stream, uint8_t* symbol) {
+    if (!decoder || !stream || !symbol || decoder->max_length == 0) return -1;
+    
+    uint32_t bits = bit_stream_peek_bits(stream, 32);
+    
+    for (uint8_t length = decoder->min_length; length <= decoder->max_length; length++) {
+        if (bits < decoder->limit[length]) {
+            if (length > bit_stream_available_bits(stream)) return -1;
+            
+            uint32_t code = bits >> (CANONICAL_MAX_LENGTH - length);
+            *symbol = decoder->symbols[decoder->offset[length] + (code - decoder->first_code[length])];
+            bit_stream_skip_bits(stream, length);
+            return 0;
+        }
+    }
+    
+    // Peek falls in the unused part of an incomplete code
+    return -1;
+}
@@ -0,0 +1,95 @@
+#include "cpu_dispatch.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// Runtime kernel selection. Every kernel variant is compiled into the
+// binary (x86 ones through function-level target attributes), so a single
+// build runs the best code each host supports.
+
+static huffman_kernels_t kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static uint32_t probe_cpu_features(void) {
+    uint32_t features = 0;
+
+#if defined(__x86_64__)
+    // cpuid via the compiler runtime. Only features some kernel selects on
+    // are probed: SSE4.2 and PCLMUL for the CRC, BMI2 for the decoder.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) features |= CPU_FEATURE_SSE42;
+    if (__builtin_cpu_supports("pclmul")) features |= CPU_FEATURE_PCLMUL;
+    if (__builtin_cpu_supports("bmi2"))   features |= CPU_FEATURE_BMI2;
+#elif defined(__aarch64__) && defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    if (hwcap & HWCAP_ASIMD) features |= CPU_FEATURE_NEON;
+    if (hwcap & HWCAP_CRC32) features |= CPU_FEATURE_CRC32;
+    if (hwcap & HWCAP_PMULL) features |= CPU_FEATURE_PMULL;
+#elif defined(__aarch64__)
+    // Every Apple Silicon core has NEON, CRC32 and PMULL
+    features |= CPU_FEATURE_NEON | CPU_FEATURE_CRC32 | CPU_FEATURE_PMULL;
+#endif
+    
+    return features;
+}
+
+static void init_kernels(void) {
+    uint32_t features = probe_cpu_features();
+    
+    const char* forced = getenv("HUFFMAN_DISPATCH");
+    if (forced && strcmp(forced, "scalar") == 0) {
+        features = 0;
+    }
+    
+    // PMULL is still reported, but only selected for CRC folding on request
+    uint32_t selectable = features;
+    if (!(forced && strcmp(forced, "pmull") == 0)) {
+        selectable &= ~CPU_FEATURE_PMULL;
+    }
+    
+    kernels.cpu_features = features;
+    decoder_select_kernels(selectable, &kernels);
+    frequency_select_kernel(selectable, &kernels);
+    crc32_select_kernel(selectable, &kernels);
+}
+
+const huffman_kernels_t* huffman_kernels(void) {
+    pthread_once(&kernels_once, init_kernels);
+    return &kernels;
+}
+
+void cpu_features_describe(uint32_t features, char* buffer, size_t size) {
+    static const struct {
+        uint32_t flag;
+        const char* name;
+    } names[] = {
+        { CPU_FEATURE_SSE42, "sse4.2" },
+        { CPU_FEATURE_PCLMUL, "pclmul" },
+        { CPU_FEATURE_BMI2, "bmi2" },
+        { CPU_FEATURE_NEON, "neon" },
+        { CPU_FEATURE_CRC32, "crc32" },
+        { CPU_FEATURE_PMULL, "pmull" },
+    };
+    
+    if (!buffer || size == 0) return;
+    buffer[0] = '\0';
+    
+    size_t used = 0;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (!(features & names[i].flag)) continue;
+        
+        int written = snprintf(buffer + used, size - used, "%s%s", used ? "," : "", names[i].name);
+        if (written < 0 || (size_t)written >= size - used) break;
+        used += (size_t)written;
+    }
+    
+    if (used == 0) {
+        snprintf(buffer, size, "none");
+    }
+}
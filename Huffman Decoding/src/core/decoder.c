@@ -1,4 +1,5 @@
 #include "decoder.h"
+#include "cpu_dispatch.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -15,6 +16,7 @@ huffman_decoder_t* huffman_decoder_create(huffman_tree_t* tree) {
     decoder->output_capacity = 1024;
     decoder->output_buffer = malloc(decoder->output_capacity);
     decoder->output_size = 0;
+    decoder->canonical.max_length = 0;
     
     // ITERATION 3: Create vectorized lookup table for NEON SIMD acceleration
     decoder->lookup_table = create_vectorized_lookup_table(tree);
@@ -30,6 +32,36 @@ huffman_decoder_t* huffman_decoder_create(huffman_tree_t* tree) {
     return decoder;
 }
 
+huffman_decoder_t* huffman_decoder_create_canonical(const uint8_t* code_lengths) {
+    if (!code_lengths) return NULL;
+    
+    huffman_decoder_t* decoder = malloc(sizeof(huffman_decoder_t));
+    if (!decoder) return NULL;
+    
+    if (canonical_decoder_build(&decoder->canonical, code_lengths) != 0) {
+        free(decoder);
+        return NULL;
+    }
+    
+    decoder->tree = NULL;
+    decoder->output_capacity = 1024;
+    decoder->output_buffer = malloc(decoder->output_capacity);
+    decoder->output_size = 0;
+    
+    // Same 12-bit two-level table as the tree path, built from the lengths
+    decoder->lookup_table = create_lookup_table_from_lengths(code_lengths, 12);
+    
+    if (!decoder->output_buffer) {
+        if (decoder->lookup_table) {
+            destroy_vectorized_lookup_table(decoder->lookup_table);
+        }
+        free(decoder);
+        return NULL;
+    }
+    
+    return decoder;
+}
+
 void huffman_decoder_destroy(huffman_decoder_t* decoder) {
     if (!decoder) return;
     
@@ -96,6 +128,15 @@ int huffman_decode_symbol(huffman_tree_t* tree, bit_stream_t* stream, uint8_t* s
     return 0;
 }
 
+// Slow-path decode of one symbol: limit/offset search for canonical decoders,
+// tree traversal otherwise
+static int decode_symbol_fallback(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* symbol) {
+    if (decoder->canonical.max_length) {
+        return canonical_decode_symbol(&decoder->canonical, stream, symbol);
+    }
+    return huffman_decode_symbol(decoder->tree, stream, symbol);
+}
+
 // ITERATION 3: NEON SIMD optimized decode function with vectorized lookup tables
 int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** output, size_t* output_size) {
     if (!decoder || !input || !output || !output_size) return -1;
@@ -141,8 +182,24 @@ int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** ou
             }
         }
     } else {
+#else
+    // Table engine in output-sized chunks until the stream runs dry
+    if (decoder->lookup_table) {
+        for (;;) {
+            if (decoder->output_capacity - decoder->output_size < 64) {
+                if (resize_output_buffer(decoder) != 0) {
+                    return -1;
+                }
+            }
+            
+            size_t room = decoder->output_capacity - decoder->output_size;
+            size_t decoded = huffman_decode_symbols(decoder, input, &decoder->output_buffer[decoder->output_size], room);
+            decoder->output_size += decoded;
+            if (decoded < room) break;
+        }
+    } else {
 #endif
-        // Fall back to tree-based decoding when lookup table not available
+        // Fall back to canonical or tree-based decoding when lookup table not available
         while (bit_stream_has_data(input)) {
             // Prefetch hint for ARM64 - likely to need more buffer space
             if (__builtin_expect(decoder->output_size >= decoder->output_capacity - 8, 0)) {
@@ -152,7 +209,7 @@ int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** ou
             }
             
             uint8_t symbol;
-            int result = huffman_decode_symbol(decoder->tree, input, &symbol);
+            int result = decode_symbol_fallback(decoder, input, &symbol);
             
             if (__builtin_expect(result != 0, 0)) {
                 break;
@@ -166,9 +223,7 @@ int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** ou
                 __builtin_prefetch(&decoder->output_buffer[decoder->output_size + 64], 1, 1);
             }
         }
-#ifdef __aarch64__
     }
-#endif
     
     *output = decoder->output_buffer;
     *output_size = decoder->output_size;
@@ -176,146 +231,369 @@ int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** ou
     return 0;
 }
 
-// ITERATION 3: NEON SIMD Vectorized Lookup Table Implementation
-// Recursively traverse tree and build lookup table entries
-static void build_lookup_table_recursive(huffman_node_t* node, uint32_t code, uint8_t depth, lookup_entry_t* table, uint8_t max_direct_bits) {
-    if (!node) return;
-    
-    if (node->is_leaf) {
-        // For direct lookup table (up to max_direct_bits) with RBIT optimization
-        if (depth <= max_direct_bits) {
-            // Fill all possible entries for this prefix
-            uint32_t prefix_shift = max_direct_bits - depth;
-            uint32_t num_entries = 1U << prefix_shift;
-            
-            // Standard lookup table construction with RBIT prefetch hints
-            for (uint32_t i = 0; i < num_entries; i++) {
-                uint32_t table_index = (code << prefix_shift) | i;
-                if (table_index < (1U << max_direct_bits)) {
-                    table[table_index].symbol = node->symbol;
-                    table[table_index].code_length = depth;
-                    
-                    // RBIT optimization: Use bit analysis for prefetch hints during construction
-                    if (depth > 8 && (i & 0xFF) == 0) {
-                        // Use RBIT for prefetch optimization without changing logic
-                        uint64_t rbit_hint = arm64_rbit64((uint64_t)table_index << 32);
-                        if (rbit_hint & 0xFFFF000000000000ULL) {
-                            __builtin_prefetch(&table[table_index + 64], 1, 1);
-                        }
-                    }
-                }
-            }
-        }
-        return;
-    }
+// Fast symbol decoding using the two-level lookup table: peek the next bits,
+// resolve the symbol in at most two probes and consume only its code length.
+int vectorized_decode_symbol(vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbol) {
+    if (!table || !table->direct_table || !stream || !symbol) return -1;
+    
+    uint32_t lookup_bits = bit_stream_peek_bits(stream, 32);
+    const lookup_entry_t* entry = &table->direct_table[lookup_bits >> (32 - table->direct_bits)];
     
-    // Recursively build for left and right children
-    if (node->left) {
-        build_lookup_table_recursive(node->left, code << 1, depth + 1, table, max_direct_bits);
+    if (entry->code_length & LOOKUP_SUBTABLE) {
+        uint8_t sub_bits = LOOKUP_SUBTABLE_BITS(entry->code_length);
+        uint32_t index = ((uint32_t)entry->symbol << sub_bits) |
+                         ((lookup_bits << table->direct_bits) >> (32 - sub_bits));
+        entry = &table->overflow_table[index];
     }
-    if (node->right) {
-        build_lookup_table_recursive(node->right, (code << 1) | 1, depth + 1, table, max_direct_bits);
+    
+    if (entry->code_length == 0 || entry->code_length > bit_stream_available_bits(stream)) {
+        return -1;
     }
+    
+    bit_stream_skip_bits(stream, entry->code_length);
+    *symbol = entry->symbol;
+    return 0;
 }
 
-vectorized_lookup_table_t* create_vectorized_lookup_table(huffman_tree_t* tree) {
-    if (!tree || !tree->root) return NULL;
-    
-    vectorized_lookup_table_t* table = malloc(sizeof(vectorized_lookup_table_t));
-    if (!table) return NULL;
-    
-    // ITERATION 3: Cache-optimized 12-bit direct lookup table (4KB, fits in L1 cache)
-    table->direct_bits = 12;  // 12-bit direct lookup (4096 entries)
-    table->direct_size = 1U << table->direct_bits;
-    table->overflow_size = 0;  // No overflow table for simplicity in iteration 3
-    table->max_code_length = 16;  // Assume max 16-bit codes
-    
-    // Allocate cache-aligned direct lookup table
-    table->direct_table = aligned_alloc(64, table->direct_size * sizeof(lookup_entry_t));
-    if (!table->direct_table) {
-        free(table);
-        return NULL;
+// Resolve one symbol from the buffered bits with at most two table probes.
+// The caller keeps at least 32 bits buffered while input remains.
+static inline int decode_one_buffered(const vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbol) {
+    // One 16-bit load per probe
+    lookup_entry_t entry = table->direct_table[stream->bit_buffer >> (64 - table->direct_bits)];
+    
+    if (__builtin_expect(entry.code_length & LOOKUP_SUBTABLE, 0)) {
+        // Second probe: index the subtable with the bits after the prefix
+        uint8_t sub_bits = LOOKUP_SUBTABLE_BITS(entry.code_length);
+        uint32_t index = ((uint32_t)entry.symbol << sub_bits) |
+                         (uint32_t)((stream->bit_buffer << table->direct_bits) >> (64 - sub_bits));
+        entry = table->overflow_table[index];
     }
     
-    // Initialize all entries to invalid state
-    memset(table->direct_table, 0, table->direct_size * sizeof(lookup_entry_t));
-    
-    // Build the lookup table from the Huffman tree
-    build_lookup_table_recursive(tree->root, 0, 0, table->direct_table, table->direct_bits);
-    
-    table->overflow_table = NULL;  // Simple implementation without overflow
+    uint8_t length = entry.code_length;
+    if (__builtin_expect(length == 0 || length > stream->bits_in_buffer, 0)) {
+        return -1;  // Invalid code or truncated stream
+    }
     
-    return table;
+    stream->bit_buffer <<= length;
+    stream->bits_in_buffer -= length;
+    *symbol = entry.symbol;
+    return 0;
 }
 
-void destroy_vectorized_lookup_table(vectorized_lookup_table_t* table) {
-    if (!table) return;
-    
-    if (table->direct_table) {
-        free(table->direct_table);
-    }
-    if (table->overflow_table) {
-        free(table->overflow_table);
+// Fast-loop variant: the caller has just refilled at least 57 bits and
+// takes no more probes than fit in them, so only invalid codes are checked
+static inline int decode_one_fast(const vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbol) {
+    lookup_entry_t entry = table->direct_table[stream->bit_buffer >> (64 - table->direct_bits)];
+    
+    if (__builtin_expect(entry.code_length & LOOKUP_SUBTABLE, 0)) {
+        uint8_t sub_bits = LOOKUP_SUBTABLE_BITS(entry.code_length);
+        uint32_t index = ((uint32_t)entry.symbol << sub_bits) |
+                         (uint32_t)((stream->bit_buffer << table->direct_bits) >> (64 - sub_bits));
+        entry = table->overflow_table[index];
     }
     
-    free(table);
+    stream->bit_buffer <<= entry.code_length;
+    stream->bits_in_buffer -= entry.code_length;
+    *symbol = entry.symbol;
+    return entry.code_length == 0;
 }
 
-// Fast vectorized symbol decoding using lookup table with CLZ optimization
-int vectorized_decode_symbol(vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbol) {
-    if (!table || !table->direct_table || !stream || !symbol) return -1;
+// One multi-symbol probe, or a single symbol when the next code is longer
+// than the window. Returns the symbols written, 0 on error; always stores
+// 4 bytes at output.
+static inline size_t decode_multi_buffered(const vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* output) {
+    multi_lookup_entry_t entry = table->multi_table[stream->bit_buffer >> (64 - table->direct_bits)];
+    uint8_t bits = MULTI_LOOKUP_BITS(entry.info);
+    
+    if (__builtin_expect(entry.info >= (1 << 4) && bits <= stream->bits_in_buffer, 1)) {
+        memcpy(output, &entry, sizeof(entry));
+        stream->bit_buffer <<= bits;
+        stream->bits_in_buffer -= bits;
+        return MULTI_LOOKUP_COUNT(entry.info);
+    }
     
-    // Read bits for direct lookup
-    uint32_t lookup_bits = bit_stream_read_bits(stream, table->direct_bits);
-    if (lookup_bits >= table->direct_size) return -1;
+    return decode_one_buffered(table, stream, output) == 0 ? 1 : 0;
+}
+
+// Table probes that always fit in the 57 bits a fast refill guarantees,
+// when each probe consumes at most step_bits (capped at 4)
+static inline unsigned probes_per_refill(const vectorized_lookup_table_t* table, uint8_t step_bits) {
+    if (table->max_code_length > step_bits) step_bits = table->max_code_length;
+    unsigned probes = step_bits ? 57 / step_bits : 1;
+    return probes > 4 ? 4 : probes;
+}
+
+// Table-driven decode engine: decodes exactly `count` symbols into `output`.
+// Each step peeks straight out of the 64-bit bit buffer and resolves the
+// symbol with one probe of the direct table, or two when the code is longer
+// than direct_bits, then consumes only its code length. With a multi-symbol
+// table one probe can emit up to MULTI_LOOKUP_MAX_SYMBOLS symbols.
+//
+// The hot loops use the fast refill: one branchless reload, then several
+// probes before the next, with no end-of-data checks in between. The last
+// few bytes of unpadded data go through the careful refill instead.
+//
+// Always inlined into the per-ISA variants at the end of this file, so each
+// copy is compiled for its own target.
+static inline __attribute__((always_inline))
+size_t decode_symbols_engine(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* output, size_t count) {
+    if (!decoder || !stream || !output) return 0;
+    
+    vectorized_lookup_table_t* table = decoder->lookup_table;
+    size_t produced = 0;
+    
+    if (table && table->direct_table) {
+        // Local copies keep the table fields and the bit buffer in registers
+        // across output stores
+        const vectorized_lookup_table_t lut = *table;
+        
+        if (table->multi_table) {
+            const unsigned probes = probes_per_refill(table, table->direct_bits);
+            bit_stream_t fast = *stream;
+            
+            // Every probe stores all 4 entry bytes, so stop while that still
+            // fits inside the caller's `count` bytes
+            while (produced + probes * sizeof(multi_lookup_entry_t) <= count &&
+                   bit_stream_can_refill_fast(&fast)) {
+                bit_stream_refill_fast(&fast);
+                
+                for (unsigned i = 0; i < probes; i++) {
+                    size_t decoded = decode_multi_buffered(&lut, &fast, &output[produced]);
+                    if (__builtin_expect(decoded == 0, 0)) return produced;
+                    produced += decoded;
+                }
+            }
+            *stream = fast;
+            
+            while (produced + sizeof(multi_lookup_entry_t) <= count) {
+                if (stream->bits_in_buffer < 32) {
+                    bit_stream_fill_buffer(stream);
+                }
+                
+                size_t decoded = decode_multi_buffered(table, stream, &output[produced]);
+                if (decoded == 0) return produced;
+                produced += decoded;
+            }
+        }
+        
+        const unsigned probes = probes_per_refill(table, 0);
+        bit_stream_t fast = *stream;
+        
+        while (produced + probes <= count && bit_stream_can_refill_fast(&fast)) {
+            bit_stream_refill_fast(&fast);
+            
+            for (unsigned i = 0; i < probes; i++) {
+                if (__builtin_expect(decode_one_fast(&lut, &fast, &output[produced]) != 0, 0)) {
+                    return produced;
+                }
+                produced++;
+            }
+        }
+        *stream = fast;
+        
+        while (produced < count) {
+            // Keep at least 32 bits (the longest code) buffered while input remains
+            if (stream->bits_in_buffer < 32) {
+                bit_stream_fill_buffer(stream);
+            }
+            
+            if (decode_one_buffered(table, stream, &output[produced]) != 0) {
+                break;
+            }
+            produced++;
+        }
+        
+        // Codes that ran into the padding mean the data was truncated
+        if (bit_stream_consumed_bits(stream) > stream->data_size * 8) {
+            return 0;
+        }
+        
+        return produced;
+    }
     
-    lookup_entry_t* entry = &table->direct_table[lookup_bits];
+    // No lookup table: canonical limit search or plain tree traversal
+    while (produced < count) {
+        if (decode_symbol_fallback(decoder, stream, &output[produced]) != 0) {
+            break;
+        }
+        produced++;
+    }
     
-    if (entry->code_length == 0) {
-        // Invalid entry, fall back to tree traversal
-        return huffman_decode_symbol(NULL, stream, symbol);  // This would need tree access
+    return produced;
+}
+
+// Multi-stream decode: one probe into each of the four streams per step.
+// Each stream's bit position only depends on its own previous code, so an
+// out-of-order core overlaps the four dependency chains instead of waiting
+// on one. Segment tails, and decoders without a table, finish one stream
+// at a time through huffman_decode_symbols.
+static inline __attribute__((always_inline))
+int decode_interleaved_engine(huffman_decoder_t* decoder, bit_stream_t* const* streams, uint8_t* output,
+                              size_t count) {
+    if (!decoder || !streams || !output) return -1;
+    
+    const size_t segment = huffman_interleave_segment(count);
+    size_t pos[HUFFMAN_INTERLEAVE_STREAMS];
+    size_t end[HUFFMAN_INTERLEAVE_STREAMS];
+    
+    for (int k = 0; k < HUFFMAN_INTERLEAVE_STREAMS; k++) {
+        if (!streams[k]) return -1;
+        pos[k] = (k * segment < count) ? k * segment : count;
+        end[k] = (pos[k] + segment < count) ? pos[k] + segment : count;
     }
     
-    // CLZ optimization: Use CLZ to efficiently handle variable-length codes
-    if (entry->code_length < table->direct_bits) {
-        uint8_t excess_bits = table->direct_bits - entry->code_length;
-        
-        // Use CLZ to optimize bit stream position adjustment
-        uint32_t code_value = lookup_bits >> excess_bits;  // Extract actual code
-        int leading_zeros = __builtin_clz(code_value);
+    const vectorized_lookup_table_t* table = decoder->lookup_table;
+    
+    if (table && table->direct_table) {
+        // Work on local copies so the table fields and the four bit buffers
+        // stay in registers across output stores
+        const vectorized_lookup_table_t lut = *table;
+        bit_stream_t lane0 = *streams[0];
+        bit_stream_t lane1 = *streams[1];
+        bit_stream_t lane2 = *streams[2];
+        bit_stream_t lane3 = *streams[3];
+        bit_stream_t* s0 = &lane0;
+        bit_stream_t* s1 = &lane1;
+        bit_stream_t* s2 = &lane2;
+        bit_stream_t* s3 = &lane3;
         
-        // RBIT optimization: Use bit reversal for optimized lookup patterns
-        uint32_t reversed_code = 0;
-        if (excess_bits > 4 && code_value != 0) {
-            // Complex code pattern - use RBIT for lookup optimization
-            reversed_code = (uint32_t)(arm64_rbit64(((uint64_t)code_value) << 32) >> 32);
+        if (table->multi_table) {
+            const unsigned probes = probes_per_refill(table, table->direct_bits);
+            const size_t room = probes * sizeof(multi_lookup_entry_t);
             
-            // RBIT-optimized prefetching based on reversed bit pattern
-            if (reversed_code & 0x0000FFFF) {
-                // High density in reversed pattern - prefetch local area
-                __builtin_prefetch(&table->direct_table[reversed_code & 0xFF], 0, 1);
-            } else {
-                // Low density - prefetch distant entries
-                __builtin_prefetch(&table->direct_table[(reversed_code >> 8) & (table->direct_size - 1)], 0, 1);
+            // Every probe stores all 4 entry bytes, so each lane needs that
+            // much room left in its own segment
+            while (pos[0] + room <= end[0] && pos[1] + room <= end[1] &&
+                   pos[2] + room <= end[2] && pos[3] + room <= end[3] &&
+                   bit_stream_can_refill_fast(s0) && bit_stream_can_refill_fast(s1) &&
+                   bit_stream_can_refill_fast(s2) && bit_stream_can_refill_fast(s3)) {
+                bit_stream_refill_fast(s0);
+                bit_stream_refill_fast(s1);
+                bit_stream_refill_fast(s2);
+                bit_stream_refill_fast(s3);
+                
+                for (unsigned i = 0; i < probes; i++) {
+                    size_t n0 = decode_multi_buffered(&lut, s0, &output[pos[0]]);
+                    size_t n1 = decode_multi_buffered(&lut, s1, &output[pos[1]]);
+                    size_t n2 = decode_multi_buffered(&lut, s2, &output[pos[2]]);
+                    size_t n3 = decode_multi_buffered(&lut, s3, &output[pos[3]]);
+                    if (__builtin_expect(!n0 || !n1 || !n2 || !n3, 0)) return -1;
+                    
+                    pos[0] += n0;
+                    pos[1] += n1;
+                    pos[2] += n2;
+                    pos[3] += n3;
+                }
             }
         } else {
-            // Standard CLZ-based optimization for simple patterns
-            if (leading_zeros > 16) {
-                // Likely short code following, prefetch near entries
-                __builtin_prefetch(&table->direct_table[lookup_bits >> 1], 0, 1);
-            } else {
-                // Likely longer code following, prefetch distant entries  
-                __builtin_prefetch(&table->direct_table[(lookup_bits << 1) & (table->direct_size - 1)], 0, 1);
+            const unsigned probes = probes_per_refill(table, 0);
+            
+            // All four segments hold at least the last segment's length, so
+            // the lanes advance in lockstep
+            uint8_t* out0 = &output[pos[0]];
+            uint8_t* out1 = &output[pos[1]];
+            uint8_t* out2 = &output[pos[2]];
+            uint8_t* out3 = &output[pos[3]];
+            const size_t rounds = end[3] - pos[3];
+            size_t i = 0;
+            
+            while (i + probes <= rounds &&
+                   bit_stream_can_refill_fast(s0) && bit_stream_can_refill_fast(s1) &&
+                   bit_stream_can_refill_fast(s2) && bit_stream_can_refill_fast(s3)) {
+                bit_stream_refill_fast(s0);
+                bit_stream_refill_fast(s1);
+                bit_stream_refill_fast(s2);
+                bit_stream_refill_fast(s3);
+                
+                for (unsigned p = 0; p < probes; p++, i++) {
+                    // Combine the status words so each step keeps a single branch
+                    int failed = decode_one_fast(&lut, s0, &out0[i]) |
+                                 decode_one_fast(&lut, s1, &out1[i]) |
+                                 decode_one_fast(&lut, s2, &out2[i]) |
+                                 decode_one_fast(&lut, s3, &out3[i]);
+                    if (__builtin_expect(failed, 0)) return -1;
+                }
+            }
+            
+            for (int k = 0; k < HUFFMAN_INTERLEAVE_STREAMS; k++) {
+                pos[k] += i;
             }
         }
         
-        // For now, assume all codes use the full lookup width (simplified)
+        *streams[0] = lane0;
+        *streams[1] = lane1;
+        *streams[2] = lane2;
+        *streams[3] = lane3;
+    }
+    
+    for (int k = 0; k < HUFFMAN_INTERLEAVE_STREAMS; k++) {
+        size_t remaining = end[k] - pos[k];
+        if (huffman_decode_symbols(decoder, streams[k], &output[pos[k]], remaining) != remaining) {
+            return -1;
+        }
+        
+        // Codes that ran into the padding mean the stream was truncated
+        if (bit_stream_consumed_bits(streams[k]) > streams[k]->data_size * 8) {
+            return -1;
+        }
     }
     
-    *symbol = entry->symbol;
     return 0;
 }
 
+// Per-ISA builds of the table engines. The BMI2 copies get flag-free
+// shlx/shrx for every variable bit-buffer shift, which shortens the
+// dependency chain through each stream.
+static size_t decode_symbols_scalar(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* output, size_t count) {
+    return decode_symbols_engine(decoder, stream, output, count);
+}
+
+static int decode_interleaved_scalar(huffman_decoder_t* decoder, bit_stream_t* const* streams, uint8_t* output, size_t count) {
+    return decode_interleaved_engine(decoder, streams, output, count);
+}
+
+#ifdef __x86_64__
+__attribute__((target("bmi2")))
+static size_t decode_symbols_bmi2(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* output, size_t count) {
+    return decode_symbols_engine(decoder, stream, output, count);
+}
+
+__attribute__((target("bmi2")))
+static int decode_interleaved_bmi2(huffman_decoder_t* decoder, bit_stream_t* const* streams, uint8_t* output, size_t count) {
+    return decode_interleaved_engine(decoder, streams, output, count);
+}
+#endif
+
+void decoder_select_kernels(uint32_t features, huffman_kernels_t* kernels) {
+    kernels->decode_symbols = decode_symbols_scalar;
+    kernels->decode_interleaved = decode_interleaved_scalar;
+    kernels->decode_variant = "scalar";
+    
+#ifdef __x86_64__
+    if (features & CPU_FEATURE_BMI2) {
+        kernels->decode_symbols = decode_symbols_bmi2;
+        kernels->decode_interleaved = decode_interleaved_bmi2;
+        kernels->decode_variant = "bmi2";
+    }
+#elif defined(__aarch64__)
+    // NEON is part of the ARM64 baseline, so the plain build is already the
+    // NEON build
+    if (features & CPU_FEATURE_NEON) {
+        kernels->decode_variant = "neon";
+    }
+#else
+    (void)features;
+#endif
+}
+
+size_t huffman_decode_symbols(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* output, size_t count) {
+    return huffman_kernels()->decode_symbols(decoder, stream, output, count);
+}
+
+int huffman_decode_interleaved(huffman_decoder_t* decoder, bit_stream_t* const* streams, uint8_t* output, size_t count) {
+    return huffman_kernels()->decode_interleaved(decoder, streams, output, count);
+}
+
 #ifdef __aarch64__
 // ITERATION 3: NEON SIMD batch symbol decoding for maximum throughput
 int neon_decode_symbols_batch(vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbols, int max_symbols) {
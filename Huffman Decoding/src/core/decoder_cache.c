@@ -0,0 +1,269 @@
+#include "decoder_cache.h"
+#include "huffman_tree.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Output size from which building the multi-symbol decode table pays off
+#ifndef MULTI_SYMBOL_MIN_OUTPUT
+#define MULTI_SYMBOL_MIN_OUTPUT (16 * 1024)
+#endif
+
+// Slots hold cached entries; an entry stays put while acquired, and only
+// unreferenced ones are evicted. Lookups scan the slots, which is cheaper
+// than any index at these sizes.
+static decoder_cache_entry_t* slots[DECODER_CACHE_MAX_ENTRIES];
+static size_t capacity = DECODER_CACHE_DEFAULT_ENTRIES;
+static uint64_t clock_tick;
+static size_t hit_count;
+static size_t miss_count;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t hash_symbol_table(const symbol_info_t* symbol_table, size_t symbol_count) {
+    const uint8_t* bytes = (const uint8_t*)symbol_table;
+    size_t length = symbol_count * sizeof(symbol_info_t);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// True when every stored code equals the canonical code for its length, i.e.
+// the lengths alone describe the code. Fills code_lengths indexed by symbol.
+static bool symbol_table_is_canonical(const symbol_info_t* symbol_table, size_t symbol_count,
+                                      uint8_t* code_lengths) {
+    if (symbol_count == 0 || symbol_count > MAX_SYMBOLS) return false;
+    
+    memset(code_lengths, 0, MAX_SYMBOLS);
+    for (size_t i = 0; i < symbol_count; i++) {
+        uint8_t length = symbol_table[i].code_length;
+        if (length == 0 || code_lengths[symbol_table[i].symbol] != 0) return false;
+        code_lengths[symbol_table[i].symbol] = length;
+    }
+    
+    uint32_t codes[MAX_SYMBOLS];
+    if (canonical_codes_from_lengths(code_lengths, codes) != 0) return false;
+    
+    for (size_t i = 0; i < symbol_count; i++) {
+        if (codes[symbol_table[i].symbol] != symbol_table[i].code) return false;
+    }
+    
+    return true;
+}
+
+// Decoder for a stored symbol table. Canonical tables (everything written
+// since make_canonical) rebuild their codes from the lengths alone, with no
+// decode tree; legacy non-canonical codes get a tree, returned in *tree for
+// the caller to destroy after the decoder.
+static huffman_decoder_t* create_decoder_for_table(const symbol_info_t* symbol_table, size_t symbol_count,
+                                                   huffman_tree_t** tree) {
+    huffman_decoder_t* decoder = NULL;
+    *tree = NULL;
+    
+    uint8_t canonical_lengths[MAX_SYMBOLS];
+    if (symbol_table_is_canonical(symbol_table, symbol_count, canonical_lengths)) {
+        return huffman_decoder_create_canonical(canonical_lengths);
+    }
+    
+    // Convert symbol table to arrays for tree building
+    uint8_t* symbols = malloc(symbol_count);
+    uint8_t* code_lengths = malloc(symbol_count);
+    uint32_t* codes = malloc(symbol_count * sizeof(uint32_t));
+    
+    if (!symbols || !code_lengths || !codes) {
+        if (symbols) free(symbols);
+        if (code_lengths) free(code_lengths);
+        if (codes) free(codes);
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < symbol_count; i++) {
+        symbols[i] = symbol_table[i].symbol;
+        code_lengths[i] = symbol_table[i].code_length;
+        codes[i] = symbol_table[i].code;
+    }
+    
+    // Build decode tree using actual codes
+    *tree = huffman_tree_from_code_table(symbols, codes, code_lengths, symbol_count);
+    free(symbols);
+    free(code_lengths);
+    free(codes);
+    
+    if (!*tree) return NULL;
+    
+    decoder = huffman_decoder_create(*tree);
+    if (!decoder) {
+        huffman_tree_destroy(*tree);
+        *tree = NULL;
+    }
+    
+    return decoder;
+}
+
+static void entry_destroy(decoder_cache_entry_t* entry) {
+    huffman_decoder_destroy(entry->decoder);
+    if (entry->tree) huffman_tree_destroy(entry->tree);
+    free(entry);
+}
+
+// Larger outputs amortize the multi-symbol table; it is optional, so a
+// failed build just leaves the single-symbol path in place. A build that
+// ran but found the table not worth keeping (high-entropy codes) is not
+// repeated on later hits.
+static void attach_multi_table(decoder_cache_entry_t* entry, size_t expected_size) {
+    vectorized_lookup_table_t* table = entry->decoder->lookup_table;
+    if (table && !entry->multi_built && expected_size >= MULTI_SYMBOL_MIN_OUTPUT) {
+        entry->multi_built = build_multi_symbol_table(table) == 0;
+    }
+}
+
+static decoder_cache_entry_t* find_entry(uint64_t hash, const symbol_info_t* symbol_table, size_t symbol_count) {
+    for (size_t i = 0; i < DECODER_CACHE_MAX_ENTRIES; i++) {
+        decoder_cache_entry_t* entry = slots[i];
+        if (entry && entry->hash == hash && entry->symbol_count == symbol_count &&
+            memcmp(entry->symbol_table, symbol_table, symbol_count * sizeof(symbol_info_t)) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Drop unreferenced entries until at most `keep` remain. Caller holds the lock.
+static void evict_to(size_t keep) {
+    for (;;) {
+        size_t used = 0;
+        int victim = -1;
+        
+        for (size_t i = 0; i < DECODER_CACHE_MAX_ENTRIES; i++) {
+            decoder_cache_entry_t* entry = slots[i];
+            if (!entry) continue;
+            
+            used++;
+            if (entry->refs == 0 && (victim < 0 || entry->last_used < slots[victim]->last_used)) {
+                victim = (int)i;
+            }
+        }
+        
+        if (used <= keep || victim < 0) return;
+        
+        entry_destroy(slots[victim]);
+        slots[victim] = NULL;
+    }
+}
+
+// Slot for a new entry after evicting down to make room, or -1 when
+// caching is off or every entry is in use. Caller holds the lock.
+static int claim_slot(void) {
+    if (capacity == 0) return -1;
+    evict_to(capacity - 1);
+    
+    size_t used = 0;
+    int free_slot = -1;
+    for (size_t i = 0; i < DECODER_CACHE_MAX_ENTRIES; i++) {
+        if (slots[i]) {
+            used++;
+        } else if (free_slot < 0) {
+            free_slot = (int)i;
+        }
+    }
+    
+    return used < capacity ? free_slot : -1;
+}
+
+decoder_cache_entry_t* decoder_cache_acquire(const symbol_info_t* symbol_table, size_t symbol_count,
+                                             size_t expected_size) {
+    if (!symbol_table || symbol_count == 0 || symbol_count > MAX_SYMBOLS) return NULL;
+    
+    uint64_t hash = hash_symbol_table(symbol_table, symbol_count);
+    
+    pthread_mutex_lock(&cache_lock);
+    decoder_cache_entry_t* entry = find_entry(hash, symbol_table, symbol_count);
+    if (entry) {
+        // Only attach the multi-symbol table while nobody else is decoding
+        // with this entry
+        if (entry->refs == 0) {
+            attach_multi_table(entry, expected_size);
+        }
+        entry->refs++;
+        entry->last_used = ++clock_tick;
+        hit_count++;
+        pthread_mutex_unlock(&cache_lock);
+        return entry;
+    }
+    miss_count++;
+    pthread_mutex_unlock(&cache_lock);
+    
+    // Build outside the lock so other tables keep decoding meanwhile
+    entry = malloc(sizeof(decoder_cache_entry_t));
+    if (!entry) return NULL;
+    
+    entry->decoder = create_decoder_for_table(symbol_table, symbol_count, &entry->tree);
+    if (!entry->decoder) {
+        free(entry);
+        return NULL;
+    }
+    entry->multi_built = false;
+    attach_multi_table(entry, expected_size);
+    
+    entry->hash = hash;
+    memcpy(entry->symbol_table, symbol_table, symbol_count * sizeof(symbol_info_t));
+    entry->symbol_count = symbol_count;
+    entry->refs = 1;
+    entry->cached = false;
+    
+    pthread_mutex_lock(&cache_lock);
+    entry->last_used = ++clock_tick;
+    
+    // Another thread may have cached the same table in the meantime; keep
+    // theirs and let this copy be freed on release
+    if (!find_entry(hash, symbol_table, symbol_count)) {
+        int slot = claim_slot();
+        if (slot >= 0) {
+            slots[slot] = entry;
+            entry->cached = true;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    
+    return entry;
+}
+
+void decoder_cache_release(decoder_cache_entry_t* entry) {
+    if (!entry) return;
+    
+    pthread_mutex_lock(&cache_lock);
+    entry->refs--;
+    bool destroy = !entry->cached && entry->refs == 0;
+    pthread_mutex_unlock(&cache_lock);
+    
+    if (destroy) {
+        entry_destroy(entry);
+    }
+}
+
+void decoder_cache_set_capacity(size_t new_capacity) {
+    if (new_capacity > DECODER_CACHE_MAX_ENTRIES) {
+        new_capacity = DECODER_CACHE_MAX_ENTRIES;
+    }
+    
+    pthread_mutex_lock(&cache_lock);
+    capacity = new_capacity;
+    evict_to(capacity);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void decoder_cache_clear(void) {
+    pthread_mutex_lock(&cache_lock);
+    evict_to(0);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void decoder_cache_stats(size_t* hits, size_t* misses) {
+    pthread_mutex_lock(&cache_lock);
+    if (hits) *hits = hit_count;
+    if (misses) *misses = miss_count;
+    pthread_mutex_unlock(&cache_lock);
+}
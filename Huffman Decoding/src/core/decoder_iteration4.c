@@ -1,4 +1,5 @@
 #include "decoder.h"
+#include "cpu_dispatch.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -12,8 +13,6 @@
 // Forward declarations for lookup table functions
 static vectorized_lookup_table_t* create_lookup_table_iteration4(huffman_tree_t* tree);
 static void destroy_lookup_table_iteration4(vectorized_lookup_table_t* table);
-static void build_lookup_table_recursive_iteration4(huffman_node_t* node, uint32_t code, uint8_t depth, 
-                                                   vectorized_lookup_table_t* table);
 static int decode_symbol_with_lookup_iteration4(vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbol);
 
 huffman_decoder_t* huffman_decoder_create(huffman_tree_t* tree) {
@@ -24,6 +23,7 @@ huffman_decoder_t* huffman_decoder_create(huffman_tree_t* tree) {
     decoder->output_capacity = 1024;
     decoder->output_buffer = malloc(decoder->output_capacity);
     decoder->output_size = 0;
+    decoder->canonical.max_length = 0;
     
     if (!decoder->output_buffer) {
         free(decoder);
@@ -39,6 +39,33 @@ huffman_decoder_t* huffman_decoder_create(huffman_tree_t* tree) {
     return decoder;
 }
 
+huffman_decoder_t* huffman_decoder_create_canonical(const uint8_t* code_lengths) {
+    if (!code_lengths) return NULL;
+    
+    huffman_decoder_t* decoder = malloc(sizeof(huffman_decoder_t));
+    if (!decoder) return NULL;
+    
+    if (canonical_decoder_build(&decoder->canonical, code_lengths) != 0) {
+        free(decoder);
+        return NULL;
+    }
+    
+    decoder->tree = NULL;
+    decoder->output_capacity = 1024;
+    decoder->output_buffer = malloc(decoder->output_capacity);
+    decoder->output_size = 0;
+    
+    if (!decoder->output_buffer) {
+        free(decoder);
+        return NULL;
+    }
+    
+    // ITERATION 4: Same 10-bit table, built from the canonical lengths
+    decoder->lookup_table = create_lookup_table_from_lengths(code_lengths, 10);
+    
+    return decoder;
+}
+
 void huffman_decoder_destroy(huffman_decoder_t* decoder) {
     if (!decoder) return;
     
@@ -90,117 +117,94 @@ int huffman_decode_symbol(huffman_tree_t* tree, bit_stream_t* stream, uint8_t* s
     return 0;
 }
 
-// ITERATION 4: Create lookup table from Huffman tree using existing types
-static vectorized_lookup_table_t* create_lookup_table_iteration4(huffman_tree_t* tree) {
-    if (!tree || !tree->root) return NULL;
-    
-    vectorized_lookup_table_t* table = malloc(sizeof(vectorized_lookup_table_t));
-    if (!table) return NULL;
-    
-    // Use 10-bit direct lookup (1024 entries, 4KB table)
-    table->direct_bits = 10;
-    table->direct_size = 1U << table->direct_bits;
-    table->overflow_size = 0;  // No overflow table
-    table->max_code_length = 0;
-    
-    // Allocate cache-aligned lookup table
-    size_t table_size = table->direct_size * sizeof(lookup_entry_t);
-    table->direct_table = aligned_alloc(64, table_size);
-    if (!table->direct_table) {
-        free(table);
-        return NULL;
+// Slow path: canonical limit search when there is no tree
+static int decode_symbol_fallback_iteration4(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* symbol) {
+    if (decoder->canonical.max_length) {
+        return canonical_decode_symbol(&decoder->canonical, stream, symbol);
     }
-    table->overflow_table = NULL;
-    
-    // Initialize all entries to zero
-    memset(table->direct_table, 0, table_size);
-    
-    // Build the lookup table from the Huffman tree
-    build_lookup_table_recursive_iteration4(tree->root, 0, 0, table);
-    
-    return table;
+    return huffman_decode_symbol(decoder->tree, stream, symbol);
 }
 
-// Recursively build lookup table entries from Huffman tree
-static void build_lookup_table_recursive_iteration4(huffman_node_t* node, uint32_t code, uint8_t depth, 
-                                                   vectorized_lookup_table_t* table) {
-    if (!node) return;
-    
-    if (node->is_leaf) {
-        // Update max code length
-        if (depth > table->max_code_length) {
-            table->max_code_length = depth;
-        }
-        
-        // Only add to direct table if code fits
-        if (depth <= table->direct_bits) {
-            // For codes shorter than direct_bits, we need to fill multiple entries
-            uint32_t base_index = code << (table->direct_bits - depth);
-            uint32_t num_entries = 1U << (table->direct_bits - depth);
-            
-            // Fill all entries that match this prefix
-            for (uint32_t i = 0; i < num_entries; i++) {
-                uint32_t index = base_index + i;
-                if (index < table->direct_size) {
-                    table->direct_table[index].symbol = node->symbol;
-                    table->direct_table[index].code_length = depth;
-                    // Note: existing lookup_entry_t doesn't have is_valid field
-                    // We use code_length > 0 to indicate valid entry
-                }
-            }
-        }
-        // Longer codes will use tree traversal fallback
-        return;
-    }
-    
-    // Recursively process children
-    if (node->left) {
-        build_lookup_table_recursive_iteration4(node->left, (code << 1), depth + 1, table);
-    }
-    if (node->right) {
-        build_lookup_table_recursive_iteration4(node->right, (code << 1) | 1, depth + 1, table);
-    }
+// ITERATION 4: 10-bit direct lookup (1024 entries) with second-level
+// subtables for longer codes, built by the shared lookup table builder
+static vectorized_lookup_table_t* create_lookup_table_iteration4(huffman_tree_t* tree) {
+    return create_lookup_table_with_bits(tree, 10);
 }
 
 // Destroy lookup table
 static void destroy_lookup_table_iteration4(vectorized_lookup_table_t* table) {
-    if (!table) return;
-    
-    if (table->direct_table) {
-        free(table->direct_table);
-    }
-    if (table->overflow_table) {
-        free(table->overflow_table);
-    }
-    free(table);
+    destroy_vectorized_lookup_table(table);
 }
 
 // ITERATION 4: Fast symbol decoding using lookup table
 static int decode_symbol_with_lookup_iteration4(vectorized_lookup_table_t* table, bit_stream_t* stream, uint8_t* symbol) {
     if (!table || !stream || !symbol) return -1;
     
-    // Peek at direct_bits bits for lookup
-    uint32_t lookup_bits = bit_stream_peek_bits(stream, table->direct_bits);
-    
-    // Check if we have enough bits
-    if (lookup_bits == 0xFFFFFFFF) {
-        // Not enough bits available, fall back to tree traversal
-        return -1;  // Signal failure - caller should use tree traversal
-    }
+    // Peek enough bits for both table levels
+    uint32_t lookup_bits = bit_stream_peek_bits(stream, 32);
     
     // Direct lookup
-    lookup_entry_t* entry = &table->direct_table[lookup_bits];
+    lookup_entry_t* entry = &table->direct_table[lookup_bits >> (32 - table->direct_bits)];
+    
+    if (entry->code_length & LOOKUP_SUBTABLE) {
+        // Code is longer than direct_bits: second probe into its subtable
+        uint8_t sub_bits = LOOKUP_SUBTABLE_BITS(entry->code_length);
+        uint32_t index = ((uint32_t)entry->symbol << sub_bits) |
+                         ((lookup_bits << table->direct_bits) >> (32 - sub_bits));
+        entry = &table->overflow_table[index];
+    }
     
-    if (entry->code_length > 0) {  // Valid entry (code_length > 0 indicates valid)
+    if (entry->code_length > 0 && entry->code_length <= bit_stream_available_bits(stream)) {
         // Found valid entry, consume only the actual code bits
         bit_stream_skip_bits(stream, entry->code_length);
         *symbol = entry->symbol;
         return 0;
-    } else {
-        // Code is longer than direct_bits, fall back to tree traversal
-        // This handles codes that don't fit in the lookup table
-        return -1;  // Signal failure - caller should use tree traversal
     }
+    
+    // Invalid code or truncated stream - caller falls back to tree traversal
+    return -1;
+}
+
+// ITERATION 4: Decode exactly `count` symbols, lookup table first
+size_t huffman_decode_symbols(huffman_decoder_t* decoder, bit_stream_t* stream, uint8_t* output, size_t count) {
+    if (!decoder || !stream || !output) return 0;
+    
+    size_t produced = 0;
+    while (produced < count) {
+        if (decode_symbol_with_lookup_iteration4(decoder->lookup_table, stream, &output[produced]) != 0 &&
+            decode_symbol_fallback_iteration4(decoder, stream, &output[produced]) != 0) {
+            break;
+        }
+        produced++;
+    }
+    
+    return produced;
+}
+
+// ITERATION 4: Interleaved streams, decoded one segment at a time
+int huffman_decode_interleaved(huffman_decoder_t* decoder, bit_stream_t* const* streams, uint8_t* output, size_t count) {
+    if (!decoder || !streams || !output) return -1;
+    
+    const size_t segment = huffman_interleave_segment(count);
+    size_t start = 0;
+    
+    for (int k = 0; k < HUFFMAN_INTERLEAVE_STREAMS; k++) {
+        size_t length = (count - start < segment) ? count - start : segment;
+        if (!streams[k] || huffman_decode_symbols(decoder, streams[k], &output[start], length) != length) {
+            return -1;
+        }
+        start += length;
+    }
+    
+    return 0;
+}
+
+// ITERATION 4: A single build of the engine, whatever the CPU
+void decoder_select_kernels(uint32_t features, huffman_kernels_t* kernels) {
+    (void)features;
+    kernels->decode_symbols = huffman_decode_symbols;
+    kernels->decode_interleaved = huffman_decode_interleaved;
+    kernels->decode_variant = "iteration4";
 }
 
 // ITERATION 4: Main decode function with lookup table optimization
@@ -239,7 +243,7 @@ int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** ou
                 }
             } else {
                 // Lookup failed, fall back to tree traversal
-                int tree_result = huffman_decode_symbol(decoder->tree, input, &symbol);
+                int tree_result = decode_symbol_fallback_iteration4(decoder, input, &symbol);
                 if (tree_result == 0) {
                     decoder->output_buffer[decoder->output_size++] = symbol;
                 } else {
@@ -266,7 +270,7 @@ int huffman_decode(huffman_decoder_t* decoder, bit_stream_t* input, uint8_t** ou
             }
             
             uint8_t symbol;
-            int result = huffman_decode_symbol(decoder->tree, input, &symbol);
+            int result = decode_symbol_fallback_iteration4(decoder, input, &symbol);
             
             if (__builtin_expect(result != 0, 0)) {
                 break;
@@ -309,17 +313,10 @@ int huffman_decode_batch_neon(huffman_decoder_t* decoder, bit_stream_t* input,
         int decoded = 0;
         
         for (int i = 0; i < 16 && bit_stream_has_data(input); i++) {
-            uint32_t lookup_bits = bit_stream_peek_bits(input, table->direct_bits);
-            if (lookup_bits == 0xFFFFFFFF) break;
-            
-            lookup_entry_t* entry = &table->direct_table[lookup_bits];
-            if (entry->code_length > 0) {  // Valid entry
-                batch[decoded++] = entry->symbol;
-                bit_stream_skip_bits(input, entry->code_length);
-            } else {
-                // Fall back to tree for this symbol - need access to decoder's tree
-                break;  // For now, exit batch mode when we encounter long codes
+            if (decode_symbol_with_lookup_iteration4(table, input, &batch[decoded]) != 0) {
+                break;
             }
+            decoded++;
         }
         
         if (decoded > 0) {
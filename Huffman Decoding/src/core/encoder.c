@@ -1,191 +1,311 @@
 #include "encoder.h"
+#include "canonical.h"
+#include "cpu_dispatch.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-// Priority queue for building Huffman tree
-typedef struct pq_node {
-    encoder_node_t* node;
-    struct pq_node* next;
-} pq_node_t;
+frequency_table_t* frequency_table_create(void) {
+    frequency_table_t* table = malloc(sizeof(frequency_table_t));
+    if (!table) return NULL;
+    
+    memset(table->frequencies, 0, sizeof(table->frequencies));
+    table->unique_symbols = 0;
+    return table;
+}
 
-typedef struct priority_queue {
-    pq_node_t* head;
-    size_t size;
-} priority_queue_t;
+void frequency_table_destroy(frequency_table_t* table) {
+    if (table) free(table);
+}
 
-static priority_queue_t* pq_create(void) {
-    priority_queue_t* pq = malloc(sizeof(priority_queue_t));
-    if (!pq) return NULL;
-    pq->head = NULL;
-    pq->size = 0;
-    return pq;
+// Single-table counting, used below MULTI_HISTOGRAM_MIN_INPUT where zeroing
+// and merging the sub-histograms costs more than the stalls they avoid
+static void count_frequencies_scalar(uint64_t* frequencies, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        frequencies[data[i]]++;
+    }
 }
 
-static void pq_insert(priority_queue_t* pq, encoder_node_t* node) {
-    pq_node_t* new_node = malloc(sizeof(pq_node_t));
-    if (!new_node) return;
-    
-    new_node->node = node;
-    new_node->next = NULL;
-    
-    if (!pq->head || node->frequency < pq->head->node->frequency ||
-        (node->frequency == pq->head->node->frequency && !node->is_leaf && pq->head->node->is_leaf)) {
-        new_node->next = pq->head;
-        pq->head = new_node;
-    } else {
-        pq_node_t* current = pq->head;
-        while (current->next && 
-               (current->next->node->frequency < node->frequency ||
-                (current->next->node->frequency == node->frequency && current->next->node->is_leaf && !node->is_leaf))) {
-            current = current->next;
+// A run of equal bytes makes every increment wait on the store of the one
+// before it. Spreading consecutive bytes over eight 32-bit sub-histograms
+// gives each table an eighth of the dependency chain, so runs count as
+// fast as mixed data. Bytes come in 8 at a time from one unaligned load;
+// the tables are summed into the caller's counts at the end.
+#define MULTI_HISTOGRAM_TABLES 8
+#define MULTI_HISTOGRAM_MIN_INPUT 512
+// Input per pass, small enough that no 32-bit sub-count can overflow
+#define MULTI_HISTOGRAM_CHUNK ((size_t)UINT32_MAX)
+
+static void count_frequencies_multi(uint64_t* frequencies, const uint8_t* data, size_t length) {
+    if (length < MULTI_HISTOGRAM_MIN_INPUT) {
+        count_frequencies_scalar(frequencies, data, length);
+        return;
+    }
+    
+    uint32_t tables[MULTI_HISTOGRAM_TABLES][MAX_SYMBOLS];
+    
+    while (length > 0) {
+        size_t chunk = (length < MULTI_HISTOGRAM_CHUNK) ? length : MULTI_HISTOGRAM_CHUNK;
+        size_t i = 0;
+        
+        memset(tables, 0, sizeof(tables));
+        for (; i + 8 <= chunk; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            
+            tables[0][word & 0xFF]++;
+            tables[1][(word >> 8) & 0xFF]++;
+            tables[2][(word >> 16) & 0xFF]++;
+            tables[3][(word >> 24) & 0xFF]++;
+            tables[4][(word >> 32) & 0xFF]++;
+            tables[5][(word >> 40) & 0xFF]++;
+            tables[6][(word >> 48) & 0xFF]++;
+            tables[7][word >> 56]++;
+        }
+        for (; i < chunk; i++) {
+            tables[0][data[i]]++;
         }
-        new_node->next = current->next;
-        current->next = new_node;
+        
+        for (int symbol = 0; symbol < MAX_SYMBOLS; symbol++) {
+            uint64_t total = 0;
+            for (int k = 0; k < MULTI_HISTOGRAM_TABLES; k++) {
+                total += tables[k][symbol];
+            }
+            frequencies[symbol] += total;
+        }
+        
+        data += chunk;
+        length -= chunk;
     }
-    pq->size++;
 }
 
-static encoder_node_t* pq_extract_min(priority_queue_t* pq) {
-    if (!pq->head) return NULL;
-    
-    pq_node_t* min_node = pq->head;
-    encoder_node_t* result = min_node->node;
-    pq->head = pq->head->next;
-    free(min_node);
-    pq->size--;
-    return result;
+void frequency_select_kernel(uint32_t features, huffman_kernels_t* kernels) {
+    // Scatter increments have no useful SIMD form short of AVX-512 conflict
+    // detection, which measures slower than this; the portable kernel wins
+    // on every target
+    (void)features;
+    kernels->count_frequencies = count_frequencies_multi;
+    kernels->histogram_variant = "multi8";
 }
 
-static void pq_destroy(priority_queue_t* pq) {
-    while (pq->head) {
-        pq_node_t* temp = pq->head;
-        pq->head = pq->head->next;
-        free(temp);
+// Derived once from the finished counts, not tracked per byte
+static void count_unique_symbols(frequency_table_t* table) {
+    table->unique_symbols = 0;
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        table->unique_symbols += (table->frequencies[i] != 0);
     }
-    free(pq);
 }
 
-frequency_table_t* frequency_table_create(void) {
-    frequency_table_t* table = malloc(sizeof(frequency_table_t));
-    if (!table) return NULL;
+int frequency_table_analyze(frequency_table_t* table, const uint8_t* data, size_t length) {
+    if (!table || !data) return -1;
     
     memset(table->frequencies, 0, sizeof(table->frequencies));
-    table->unique_symbols = 0;
-    return table;
+    huffman_kernels()->count_frequencies(table->frequencies, data, length);
+    count_unique_symbols(table);
+    
+    return 0;
 }
 
-void frequency_table_destroy(frequency_table_t* table) {
-    if (table) free(table);
-}
+// Large enough to amortize the histogram kernel's per-call merge, small
+// enough to still be in L2 when the CRC reads it back
+#define CHECKSUM_CHUNK (64 * 1024)
 
-int frequency_table_analyze(frequency_table_t* table, const uint8_t* data, size_t length) {
-    if (!table || !data) return -1;
+int frequency_table_analyze_checksum(frequency_table_t* table, const uint8_t* data, size_t length,
+                                     uint32_t* checksum) {
+    if (!table || !data || !checksum) return -1;
+    
+    const huffman_kernels_t* kernels = huffman_kernels();
+    uint32_t crc = 0xFFFFFFFF;
     
     memset(table->frequencies, 0, sizeof(table->frequencies));
-    table->unique_symbols = 0;
+    for (size_t offset = 0; offset < length; offset += CHECKSUM_CHUNK) {
+        size_t chunk = (length - offset < CHECKSUM_CHUNK) ? length - offset : CHECKSUM_CHUNK;
+        kernels->count_frequencies(table->frequencies, data + offset, chunk);
+        crc = kernels->crc32_update(crc, data + offset, chunk);
+    }
+    count_unique_symbols(table);
     
-    for (size_t i = 0; i < length; i++) {
-        if (table->frequencies[data[i]] == 0) {
-            table->unique_symbols++;
+    *checksum = crc ^ 0xFFFFFFFF;
+    return 0;
+}
+
+// Linear-time code construction. The used symbols are sorted by
+// frequency once; after that the merged nodes come out in non-decreasing
+// weight order, so a second FIFO queue replaces the priority queue and each
+// merge just takes the lighter of the two queue heads. Everything lives in
+// fixed-size stack arrays, so no node is ever heap-allocated.
+typedef struct weighted_symbol {
+    uint64_t frequency;
+    uint8_t symbol;
+} weighted_symbol_t;
+
+static int compare_weighted_symbols(const void* a, const void* b) {
+    const weighted_symbol_t* x = a;
+    const weighted_symbol_t* y = b;
+    
+    if (x->frequency != y->frequency) return x->frequency < y->frequency ? -1 : 1;
+    return (int)x->symbol - (int)y->symbol;
+}
+
+// Package-merge (Larmore & Hirschberg): optimal code lengths of at most
+// max_length bits for leaves sorted by ascending frequency. List d holds the
+// leaves merged with the pairwise packages of list d+1; the first 2n-2
+// items of list 1 are selected, and each selected package selects the two
+// items it was made from, which are always a prefix of the list below. A
+// symbol's code length is the number of levels at which its leaf is
+// selected. Only which item each slot holds is kept per level, so the whole
+// thing fits in fixed stack arrays.
+static int package_merge(const weighted_symbol_t* leaves, size_t count, uint8_t max_length,
+                         uint8_t* code_lengths) {
+    if (max_length == 0 || max_length > MAX_CODE_LENGTH) return -1;
+    if (max_length < huffman_min_code_length(count)) return -1;
+    
+    // item[d][k]: leaf index of slot k in list d, or -1 for a package
+    int16_t item[MAX_CODE_LENGTH + 1][2 * MAX_SYMBOLS];
+    uint64_t weights[2][2 * MAX_SYMBOLS];
+    size_t list_size = count;
+    
+    for (size_t i = 0; i < count; i++) {
+        item[max_length][i] = (int16_t)i;
+        weights[max_length & 1][i] = leaves[i].frequency;
+    }
+    
+    for (int d = max_length - 1; d >= 1; d--) {
+        const uint64_t* below = weights[(d + 1) & 1];
+        uint64_t* merged = weights[d & 1];
+        size_t packages = list_size / 2;
+        size_t next_leaf = 0;
+        size_t next_package = 0;
+        size_t k = 0;
+        
+        while (next_leaf < count || next_package < packages) {
+            uint64_t package_weight = (next_package < packages)
+                ? below[2 * next_package] + below[2 * next_package + 1] : 0;
+            
+            if (next_package == packages || (next_leaf < count && leaves[next_leaf].frequency <= package_weight)) {
+                merged[k] = leaves[next_leaf].frequency;
+                item[d][k++] = (int16_t)next_leaf++;
+            } else {
+                merged[k] = package_weight;
+                item[d][k++] = -1;
+                next_package++;
+            }
+        }
+        list_size = k;
+    }
+    
+    memset(code_lengths, 0, MAX_SYMBOLS);
+    size_t selected = 2 * count - 2;
+    for (int d = 1; d <= max_length && selected > 0; d++) {
+        size_t packages = 0;
+        for (size_t k = 0; k < selected; k++) {
+            if (item[d][k] < 0) {
+                packages++;
+            } else {
+                code_lengths[leaves[item[d][k]].symbol]++;
+            }
         }
-        table->frequencies[data[i]]++;
+        selected = 2 * packages;
     }
     
     return 0;
 }
 
-static encoder_node_t* create_encoder_node(uint8_t symbol, uint64_t frequency, bool is_leaf) {
-    encoder_node_t* node = malloc(sizeof(encoder_node_t));
-    if (!node) return NULL;
-    
-    node->symbol = symbol;
-    node->frequency = frequency;
-    node->is_leaf = is_leaf;
-    node->left = NULL;
-    node->right = NULL;
-    return node;
+int build_code_lengths(const frequency_table_t* freq_table, uint8_t* code_lengths) {
+    return build_limited_code_lengths(freq_table, MAX_CODE_LENGTH, code_lengths);
+}
+
+uint8_t huffman_min_code_length(size_t symbol_count) {
+    uint8_t length = 1;
+    while (length < 64 && ((uint64_t)1 << length) < symbol_count) {
+        length++;
+    }
+    return length;
 }
 
-encoder_node_t* build_huffman_tree(const frequency_table_t* freq_table) {
-    if (!freq_table || freq_table->unique_symbols == 0) return NULL;
+int build_limited_code_lengths(const frequency_table_t* freq_table, uint8_t max_length,
+                               uint8_t* code_lengths) {
+    if (!freq_table || !code_lengths || max_length == 0 || max_length > MAX_CODE_LENGTH) return -1;
     
-    priority_queue_t* pq = pq_create();
-    if (!pq) return NULL;
+    memset(code_lengths, 0, MAX_SYMBOLS);
     
-    // Add all symbols with non-zero frequency to priority queue
+    weighted_symbol_t leaves[MAX_SYMBOLS];
+    size_t count = 0;
     for (int i = 0; i < MAX_SYMBOLS; i++) {
         if (freq_table->frequencies[i] > 0) {
-            encoder_node_t* node = create_encoder_node(i, freq_table->frequencies[i], true);
-            if (node) {
-                pq_insert(pq, node);
-            }
+            leaves[count].frequency = freq_table->frequencies[i];
+            leaves[count].symbol = (uint8_t)i;
+            count++;
         }
     }
     
+    if (count == 0) return -1;
+    
     // Handle single symbol case
-    if (pq->size == 1) {
-        encoder_node_t* single = pq_extract_min(pq);
-        encoder_node_t* root = create_encoder_node(0, single->frequency, false);
-        if (root) {
-            root->left = single;
-        }
-        pq_destroy(pq);
-        return root;
+    if (count == 1) {
+        code_lengths[leaves[0].symbol] = 1;
+        return 0;
     }
     
-    // Build tree by combining nodes
-    while (pq->size > 1) {
-        encoder_node_t* left = pq_extract_min(pq);
-        encoder_node_t* right = pq_extract_min(pq);
-        
-        encoder_node_t* parent = create_encoder_node(0, left->frequency + right->frequency, false);
-        if (!parent) {
-            pq_destroy(pq);
-            return NULL;
-        }
-        
-        parent->left = left;
-        parent->right = right;
-        pq_insert(pq, parent);
+    qsort(leaves, count, sizeof(weighted_symbol_t), compare_weighted_symbols);
+    
+    // Nodes 0..count-1 are the sorted leaves, count.. the merged nodes in
+    // creation order; the last one created is the root
+    uint64_t weight[2 * MAX_SYMBOLS - 1];
+    uint16_t parent[2 * MAX_SYMBOLS - 1];
+    uint8_t depth[2 * MAX_SYMBOLS - 1];
+    
+    for (size_t i = 0; i < count; i++) {
+        weight[i] = leaves[i].frequency;
     }
     
-    encoder_node_t* root = pq_extract_min(pq);
-    pq_destroy(pq);
-    return root;
-}
-
-void destroy_encoder_tree(encoder_node_t* root) {
-    if (!root) return;
+    size_t next_leaf = 0;
+    size_t next_merged = count;
+    size_t total = count;
     
-    destroy_encoder_tree(root->left);
-    destroy_encoder_tree(root->right);
-    free(root);
-}
-
-static void generate_codes_recursive(encoder_node_t* node, code_table_t* table, uint32_t code, uint8_t depth) {
-    if (!node || !table) return;
-    
-    if (node->is_leaf) {
-        table->codes[node->symbol].code = code;
-        table->codes[node->symbol].length = depth;
-        table->codes[node->symbol].valid = true;
-        if (depth > table->max_length) {
-            table->max_length = depth;
+    while (total < 2 * count - 1) {
+        size_t pair[2];
+        for (int k = 0; k < 2; k++) {
+            // Ties go to the leaf, which keeps the code lengths shallow
+            if (next_leaf < count && (next_merged == total || weight[next_leaf] <= weight[next_merged])) {
+                pair[k] = next_leaf++;
+            } else {
+                pair[k] = next_merged++;
+            }
         }
-        return;
+        
+        weight[total] = weight[pair[0]] + weight[pair[1]];
+        parent[pair[0]] = (uint16_t)total;
+        parent[pair[1]] = (uint16_t)total;
+        total++;
+    }
+    
+    // Parents always come after their children, so a single backwards pass
+    // assigns every depth
+    depth[total - 1] = 0;
+    for (size_t i = total - 1; i-- > 0;) {
+        depth[i] = depth[parent[i]] + 1;
     }
     
-    if (node->left) {
-        generate_codes_recursive(node->left, table, code << 1, depth + 1);
+    // Plain Huffman is optimal whenever it already fits; package-merge is
+    // only needed for the rare histograms that run deeper than the limit
+    uint8_t longest = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (depth[i] > longest) longest = depth[i];
+    }
+    if (longest > max_length) {
+        return package_merge(leaves, count, max_length, code_lengths);
     }
-    if (node->right) {
-        generate_codes_recursive(node->right, table, (code << 1) | 1, depth + 1);
+    
+    for (size_t i = 0; i < count; i++) {
+        code_lengths[leaves[i].symbol] = depth[i];
     }
+    
+    return 0;
 }
 
-code_table_t* generate_codes(encoder_node_t* root) {
-    if (!root) return NULL;
+code_table_t* code_table_from_lengths(const uint8_t* code_lengths) {
+    if (!code_lengths) return NULL;
     
     code_table_t* table = malloc(sizeof(code_table_t));
     if (!table) return NULL;
@@ -193,21 +313,49 @@ code_table_t* generate_codes(encoder_node_t* root) {
     memset(table->codes, 0, sizeof(table->codes));
     table->max_length = 0;
     
-    // Handle single symbol case
-    if (!root->left && !root->right) {
-        if (root->is_leaf) {
-            table->codes[root->symbol].code = 0;
-            table->codes[root->symbol].length = 1;
-            table->codes[root->symbol].valid = true;
-            table->max_length = 1;
-        }
-        return table;
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        if (code_lengths[i] == 0) continue;
+        
+        table->codes[i].length = code_lengths[i];
+        table->codes[i].valid = true;
+    }
+    
+    if (make_canonical(table) != 0) {
+        free(table);
+        return NULL;
     }
     
-    generate_codes_recursive(root, table, 0, 0);
     return table;
 }
 
+// Reassign codes in canonical (length, symbol) order. The lengths, and so the
+// compressed size, are unchanged; the decoder can then rebuild every code
+// from the lengths alone.
+int make_canonical(code_table_t* table) {
+    if (!table) return -1;
+    
+    uint8_t code_lengths[MAX_SYMBOLS];
+    uint32_t codes[MAX_SYMBOLS];
+    
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        code_lengths[i] = table->codes[i].valid ? table->codes[i].length : 0;
+    }
+    
+    if (canonical_codes_from_lengths(code_lengths, codes) != 0) return -1;
+    
+    table->max_length = 0;
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        if (!table->codes[i].valid) continue;
+        
+        table->codes[i].code = codes[i];
+        if (table->codes[i].length > table->max_length) {
+            table->max_length = table->codes[i].length;
+        }
+    }
+    
+    return 0;
+}
+
 void code_table_destroy(code_table_t* table) {
     if (table) free(table);
 }
@@ -251,11 +399,13 @@ int bit_writer_write_bits(bit_writer_t* writer, uint32_t bits, uint8_t count) {
     writer->bit_buffer = (writer->bit_buffer << count) | bits;
     writer->bits_in_buffer += count;
     
+    // At most 4 whole bytes can be pending (7 + 32 bits), so one capacity
+    // check covers the whole call
+    if (writer->buffer_capacity - writer->buffer_size < 4) {
+        if (bit_writer_expand(writer) != 0) return -1;
+    }
+    
     while (writer->bits_in_buffer >= 8) {
-        if (writer->buffer_size >= writer->buffer_capacity) {
-            if (bit_writer_expand(writer) != 0) return -1;
-        }
-        
         uint8_t byte = (writer->bit_buffer >> (writer->bits_in_buffer - 8)) & 0xFF;
         writer->buffer[writer->buffer_size++] = byte;
         writer->bits_in_buffer -= 8;
@@ -290,4 +440,69 @@ uint8_t* bit_writer_get_data(bit_writer_t* writer, size_t* size) {
     if (!writer || !size) return NULL;
     *size = writer->buffer_size;
     return writer->buffer;
+}
+
+uint64_t code_table_encoded_bits(const code_table_t* table, const frequency_table_t* freq_table) {
+    if (!table || !freq_table) return 0;
+    
+    uint64_t bits = 0;
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        bits += freq_table->frequencies[i] * table->codes[i].length;
+    }
+    return bits;
+}
+
+// Pending bits, left-justified, as one big-endian 64-bit store
+static inline void store_bits_be64(uint8_t* output, uint64_t bits, unsigned count) {
+    uint64_t word = __builtin_bswap64(bits << (64 - count));
+    memcpy(output, &word, sizeof(word));
+}
+
+// Codes accumulate in a 64-bit register; once 32 or more bits are pending
+// the whole register goes out in one unaligned store and the pointer moves
+// past the completed bytes, leaving at most 7 bits behind. Up to 31 bits can
+// be pending before the next check, so short codes (max_length <= 16) take
+// two symbols per check: 31 + 2 * 16 bits still fit.
+size_t huffman_encode_into(const code_table_t* table, const uint8_t* data, size_t size, uint8_t* output) {
+    const huffman_code_t* codes = table->codes;
+    uint8_t* out = output;
+    uint64_t bits = 0;
+    unsigned count = 0;
+    size_t i = 0;
+    
+    if (table->max_length <= 16) {
+        for (; i + 2 <= size; i += 2) {
+            const huffman_code_t* first = &codes[data[i]];
+            const huffman_code_t* second = &codes[data[i + 1]];
+            bits = (bits << first->length) | first->code;
+            bits = (bits << second->length) | second->code;
+            count += first->length + second->length;
+            
+            if (count >= 32) {
+                store_bits_be64(out, bits, count);
+                out += count >> 3;
+                count &= 7;
+            }
+        }
+    }
+    
+    for (; i < size; i++) {
+        const huffman_code_t* code = &codes[data[i]];
+        bits = (bits << code->length) | code->code;
+        count += code->length;
+        
+        if (count >= 32) {
+            store_bits_be64(out, bits, count);
+            out += count >> 3;
+            count &= 7;
+        }
+    }
+    
+    // Final partial byte, zero-padded
+    if (count > 0) {
+        store_bits_be64(out, bits, count);
+        out += (count + 7) >> 3;
+    }
+    
+    return (size_t)(out - output);
 }
\ No newline at end of file
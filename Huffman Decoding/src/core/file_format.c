@@ -1,7 +1,18 @@
 #include "file_format.h"
+#include "cpu_dispatch.h"
+#include "canonical.h"
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __aarch64__
+#include <arm_acle.h>
+#include <arm_neon.h>
+#endif
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
 static const uint32_t crc32_table[256] = {
     0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
     0xE963A535, 0x9E6495A3, 0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
@@ -48,14 +59,336 @@ static const uint32_t crc32_table[256] = {
     0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
-uint32_t calculate_crc32(const uint8_t* data, size_t length) {
-    uint32_t crc = 0xFFFFFFFF;
+// crc32_slice[k][b] is the CRC of byte b followed by k zero bytes, so eight
+// input bytes fold into the register with eight independent lookups.
+// crc32_slice[0] is crc32_table; the rest are filled in once at dispatch.
+static uint32_t crc32_slice[8][256];
+
+static void crc32_build_slices(void) {
+    memcpy(crc32_slice[0], crc32_table, sizeof(crc32_table));
+    for (int k = 1; k < 8; k++) {
+        for (int b = 0; b < 256; b++) {
+            uint32_t previous = crc32_slice[k - 1][b];
+            crc32_slice[k][b] = (previous >> 8) ^ crc32_table[previous & 0xFF];
+        }
+    }
+}
+
+// Slice-by-8 over little-endian 64-bit loads, byte at a time for the tail
+static uint32_t crc32_update_slice8(uint32_t crc, const uint8_t* data, size_t length) {
+    while (length >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        word ^= crc;
+        
+        crc = crc32_slice[7][word & 0xFF] ^ crc32_slice[6][(word >> 8) & 0xFF] ^
+              crc32_slice[5][(word >> 16) & 0xFF] ^ crc32_slice[4][(word >> 24) & 0xFF] ^
+              crc32_slice[3][(word >> 32) & 0xFF] ^ crc32_slice[2][(word >> 40) & 0xFF] ^
+              crc32_slice[1][(word >> 48) & 0xFF] ^ crc32_slice[0][word >> 56];
+        data += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+    }
+    while (length--) {
+        crc = crc32_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// Carry-less multiply folding (Intel, "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ"), with the constants for the reflected
+// CRC-32 polynomial: four 128-bit lanes fold 64 bytes per step, collapse to
+// one lane, fold the remaining 16-byte blocks, then a Barrett reduction
+// yields the 32-bit register. Needs at least 64 bytes, in 16-byte multiples.
+#define CRC32_FOLD_MIN 64
+static const uint64_t crc32_k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t crc32_k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t crc32_k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t crc32_poly[2] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+
+#ifdef __x86_64__
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_fold_pclmul(uint32_t crc, const uint8_t* data, size_t length) {
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    
+    x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)crc32_k1k2);
+    data += 64;
+    length -= 64;
+    
+    // Fold four lanes 64 bytes ahead
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 0x30)));
+        data += 64;
+        length -= 64;
+    }
+    
+    // Fold the four lanes into one, then the remaining 16-byte blocks
+    x0 = _mm_load_si128((const __m128i*)crc32_k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+    
+    while (length >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        length -= 16;
+    }
+    
+    // 128 bits down to 64
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    x0 = _mm_loadl_epi64((const __m128i*)crc32_k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)crc32_poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_update_pclmul(uint32_t crc, const uint8_t* data, size_t length) {
+    if (length >= CRC32_FOLD_MIN) {
+        size_t folded = length & ~(size_t)15;
+        crc = crc32_fold_pclmul(crc, data, folded);
+        data += folded;
+        length -= folded;
+    }
+    return crc32_update_slice8(crc, data, length);
+}
+#endif
+
+#ifdef __aarch64__
+// PMULL versions of the x86 operations used above
+#ifdef __clang__
+#define CRC32_PMULL_TARGET __attribute__((target("aes")))
+#else
+#define CRC32_PMULL_TARGET __attribute__((target("+crypto")))
+#endif
+
+// _mm_clmulepi64_si128(a, b, 0x00), (a, b, 0x11) and (a, b, 0x10)
+CRC32_PMULL_TARGET
+static inline uint64x2_t clmul_lo(uint64x2_t a, uint64x2_t b) {
+    return vreinterpretq_u64_p128(vmull_p64(vgetq_lane_u64(a, 0), vgetq_lane_u64(b, 0)));
+}
+
+CRC32_PMULL_TARGET
+static inline uint64x2_t clmul_hi(uint64x2_t a, uint64x2_t b) {
+    return vreinterpretq_u64_p128(vmull_p64(vgetq_lane_u64(a, 1), vgetq_lane_u64(b, 1)));
+}
+
+CRC32_PMULL_TARGET
+static inline uint64x2_t clmul_lo_hi(uint64x2_t a, uint64x2_t b) {
+    return vreinterpretq_u64_p128(vmull_p64(vgetq_lane_u64(a, 0), vgetq_lane_u64(b, 1)));
+}
+
+// _mm_srli_si128: shift the whole register right by n bytes
+#define shift_right_bytes(x, n) \
+    vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(x), vdupq_n_u8(0), (n)))
+
+CRC32_PMULL_TARGET
+static uint32_t crc32_fold_pmull(uint32_t crc, const uint8_t* data, size_t length) {
+    uint64x2_t x0, x1, x2, x3, x4, x5, x6, x7, x8;
     
-    for (size_t i = 0; i < length; i++) {
-        crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    x1 = vld1q_u64((const uint64_t*)(const void*)(data + 0x00));
+    x2 = vld1q_u64((const uint64_t*)(const void*)(data + 0x10));
+    x3 = vld1q_u64((const uint64_t*)(const void*)(data + 0x20));
+    x4 = vld1q_u64((const uint64_t*)(const void*)(data + 0x30));
+    x1 = veorq_u64(x1, vsetq_lane_u64((uint64_t)crc, vdupq_n_u64(0), 0));
+    x0 = vld1q_u64(crc32_k1k2);
+    data += 64;
+    length -= 64;
+    
+    // Fold four lanes 64 bytes ahead
+    while (length >= 64) {
+        x5 = clmul_lo(x1, x0);
+        x6 = clmul_lo(x2, x0);
+        x7 = clmul_lo(x3, x0);
+        x8 = clmul_lo(x4, x0);
+        x1 = clmul_hi(x1, x0);
+        x2 = clmul_hi(x2, x0);
+        x3 = clmul_hi(x3, x0);
+        x4 = clmul_hi(x4, x0);
+        
+        x1 = veorq_u64(veorq_u64(x1, x5), vld1q_u64((const uint64_t*)(const void*)(data + 0x00)));
+        x2 = veorq_u64(veorq_u64(x2, x6), vld1q_u64((const uint64_t*)(const void*)(data + 0x10)));
+        x3 = veorq_u64(veorq_u64(x3, x7), vld1q_u64((const uint64_t*)(const void*)(data + 0x20)));
+        x4 = veorq_u64(veorq_u64(x4, x8), vld1q_u64((const uint64_t*)(const void*)(data + 0x30)));
+        data += 64;
+        length -= 64;
+    }
+    
+    // Fold the four lanes into one, then the remaining 16-byte blocks
+    x0 = vld1q_u64(crc32_k3k4);
+    x5 = clmul_lo(x1, x0);
+    x1 = clmul_hi(x1, x0);
+    x1 = veorq_u64(veorq_u64(x1, x2), x5);
+    x5 = clmul_lo(x1, x0);
+    x1 = clmul_hi(x1, x0);
+    x1 = veorq_u64(veorq_u64(x1, x3), x5);
+    x5 = clmul_lo(x1, x0);
+    x1 = clmul_hi(x1, x0);
+    x1 = veorq_u64(veorq_u64(x1, x4), x5);
+    
+    while (length >= 16) {
+        x2 = vld1q_u64((const uint64_t*)(const void*)data);
+        x5 = clmul_lo(x1, x0);
+        x1 = clmul_hi(x1, x0);
+        x1 = veorq_u64(veorq_u64(x1, x2), x5);
+        data += 16;
+        length -= 16;
     }
     
-    return crc ^ 0xFFFFFFFF;
+    // 128 bits down to 64
+    x2 = clmul_lo_hi(x1, x0);
+    x3 = vreinterpretq_u64_u32((uint32x4_t){ ~0u, 0, ~0u, 0 });
+    x1 = shift_right_bytes(x1, 8);
+    x1 = veorq_u64(x1, x2);
+    
+    x0 = vld1q_u64(crc32_k5k0);
+    x2 = shift_right_bytes(x1, 4);
+    x1 = vandq_u64(x1, x3);
+    x1 = clmul_lo(x1, x0);
+    x1 = veorq_u64(x1, x2);
+    
+    // Barrett reduction to 32 bits
+    x0 = vld1q_u64(crc32_poly);
+    x2 = vandq_u64(x1, x3);
+    x2 = clmul_lo_hi(x2, x0);
+    x2 = vandq_u64(x2, x3);
+    x2 = clmul_lo(x2, x0);
+    x1 = veorq_u64(x1, x2);
+    
+    return vgetq_lane_u32(vreinterpretq_u32_u64(x1), 1);
+}
+
+static uint32_t crc32_update_pmull(uint32_t crc, const uint8_t* data, size_t length) {
+    if (length >= CRC32_FOLD_MIN) {
+        size_t folded = length & ~(size_t)15;
+        crc = crc32_fold_pmull(crc, data, folded);
+        data += folded;
+        length -= folded;
+    }
+    return crc32_update_slice8(crc, data, length);
+}
+#endif
+
+#ifdef __aarch64__
+// The ARMv8 CRC32 instructions implement this same reflected polynomial
+// (the CRC32C ones, like x86's SSE4.2 crc32, do not), eight bytes at a time
+#ifdef __clang__
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+static uint32_t crc32_update_armv8(uint32_t crc, const uint8_t* data, size_t length) {
+    while (length >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32d(crc, word);
+        data += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+    }
+    while (length--) {
+        crc = __crc32b(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+void crc32_select_kernel(uint32_t features, huffman_kernels_t* kernels) {
+    crc32_build_slices();
+    kernels->crc32_update = crc32_update_slice8;
+    kernels->crc32_variant = "slice8";
+
+#if defined(__x86_64__)
+    if ((features & CPU_FEATURE_PCLMUL) && (features & CPU_FEATURE_SSE42)) {
+        kernels->crc32_update = crc32_update_pclmul;
+        kernels->crc32_variant = "pclmul";
+    }
+#elif defined(__aarch64__)
+    // Folding keeps several multiplies in flight; the CRC32 instructions are
+    // one serial dependency chain. PMULL only arrives here when requested
+    // (cpu_dispatch.c), so the CRC32 instructions are the default.
+    if (features & CPU_FEATURE_PMULL) {
+        kernels->crc32_update = crc32_update_pmull;
+        kernels->crc32_variant = "pmull";
+    } else if (features & CPU_FEATURE_CRC32) {
+        kernels->crc32_update = crc32_update_armv8;
+        kernels->crc32_variant = "armv8-crc32";
+    }
+#else
+    (void)features;
+#endif
+}
+
+uint32_t calculate_crc32(const uint8_t* data, size_t length) {
+    return huffman_kernels()->crc32_update(0xFFFFFFFF, data, length) ^ 0xFFFFFFFF;
+}
+
+// x^(2^k) modulo the reflected CRC-32 polynomial, for k = 0..31
+static const uint32_t crc32_x2n_table[32] = {
+    0x40000000, 0x20000000, 0x08000000, 0x00800000, 0x00008000, 0xEDB88320,
+    0xB1E6B092, 0xA06A2517, 0xED627DAE, 0x88D14467, 0xD7BBFE6A, 0xEC447F11,
+    0x8E7EA170, 0x6427800E, 0x4D47BAE0, 0x09FE548F, 0x83852D0F, 0x30362F1A,
+    0x7B5A9CC3, 0x31FEC169, 0x9FEC022A, 0x6C8DEDC4, 0x15D6874D, 0x5FDE7A4E,
+    0xBAD90E37, 0x2E4E5EEF, 0x4EABA214, 0xA8A472C0, 0x429A969E, 0x148D302A,
+    0xC40BA6D0, 0xC4E22C3C
+};
+
+// a * b modulo the polynomial, both in reflected bit order
+static uint32_t crc32_multiply_mod(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t bit = 1u << 31; bit != 0; bit >>= 1) {
+        if (a & bit) product ^= b;
+        b = (b & 1) ? (b >> 1) ^ 0xEDB88320 : b >> 1;
+    }
+    return product;
+}
+
+// Appending n bytes multiplies the register by x^(8n); square-and-multiply
+// over the bits of n with the table above
+uint32_t calculate_crc32_combine(uint32_t crc_a, uint32_t crc_b, uint64_t length_b) {
+    uint32_t shift = 1u << 31;  // x^0
+    for (unsigned k = 3; length_b != 0; length_b >>= 1, k++) {
+        if (length_b & 1) shift = crc32_multiply_mod(crc32_x2n_table[k & 31], shift);
+    }
+    return crc32_multiply_mod(shift, crc_a) ^ crc_b;
 }
 
 int huffman_write_header(FILE* file, const huffman_header_t* header) {
@@ -73,7 +406,8 @@ int huffman_read_header(FILE* file, huffman_header_t* header) {
     
     // Validate magic number
     if (header->magic != HUFFMAN_MAGIC) return -1;
-    if (header->version != HUFFMAN_VERSION) return -1;
+    if (header->version != HUFFMAN_VERSION && header->version != HUFFMAN_VERSION_SINGLE) return -1;
+    if (header->flags & ~HUFFMAN_KNOWN_FLAGS) return -1;
     
     return 0;
 }
@@ -90,4 +424,77 @@ int huffman_read_symbol_table(FILE* file, symbol_info_t* symbols, size_t count)
     
     size_t read = fread(symbols, sizeof(symbol_info_t), count, file);
     return (read == count) ? 0 : -1;
-}
\ No newline at end of file
+}
+
+// Range of used symbols; -1 when a length does not fit a nibble or none is used
+static int packed_range(const uint8_t* code_lengths, int* first, int* last) {
+    *first = -1;
+    *last = -1;
+    for (int i = 0; i < CANONICAL_MAX_SYMBOLS; i++) {
+        if (code_lengths[i] == 0) continue;
+        if (code_lengths[i] > HUFFMAN_PACKED_MAX_LENGTH) return -1;
+        
+        if (*first < 0) *first = i;
+        *last = i;
+    }
+    return *first < 0 ? -1 : 0;
+}
+
+size_t huffman_packed_lengths_size(const uint8_t* code_lengths) {
+    int first, last;
+    if (!code_lengths || packed_range(code_lengths, &first, &last) != 0) return 0;
+    
+    return 2 + (size_t)(last - first + 2) / 2;
+}
+
+size_t huffman_pack_lengths(const uint8_t* code_lengths, uint8_t* output) {
+    int first, last;
+    if (!code_lengths || !output || packed_range(code_lengths, &first, &last) != 0) return 0;
+    
+    output[0] = (uint8_t)first;
+    output[1] = (uint8_t)last;
+    
+    size_t size = 2 + (size_t)(last - first + 2) / 2;
+    memset(output + 2, 0, size - 2);
+    for (int i = first; i <= last; i++) {
+        output[2 + (i - first) / 2] |= (uint8_t)(code_lengths[i] << (((i - first) & 1) * 4));
+    }
+    
+    return size;
+}
+
+int huffman_unpack_lengths(const uint8_t* input, size_t input_size, uint8_t* code_lengths, size_t* consumed) {
+    if (!input || !code_lengths || !consumed || input_size < 2 || input[0] > input[1]) return -1;
+    
+    const int first = input[0];
+    const int last = input[1];
+    const size_t size = 2 + (size_t)(last - first + 2) / 2;
+    if (size > input_size) return -1;
+    
+    memset(code_lengths, 0, CANONICAL_MAX_SYMBOLS);
+    for (int i = first; i <= last; i++) {
+        code_lengths[i] = (input[2 + (i - first) / 2] >> (((i - first) & 1) * 4)) & 0x0F;
+    }
+    
+    *consumed = size;
+    return 0;
+}
+
+int huffman_symbols_from_lengths(const uint8_t* code_lengths, symbol_info_t* symbols) {
+    if (!code_lengths || !symbols) return -1;
+    
+    uint32_t codes[CANONICAL_MAX_SYMBOLS];
+    if (canonical_codes_from_lengths(code_lengths, codes) != 0) return -1;
+    
+    int count = 0;
+    for (int i = 0; i < CANONICAL_MAX_SYMBOLS; i++) {
+        if (code_lengths[i] == 0) continue;
+        
+        symbols[count].symbol = (uint8_t)i;
+        symbols[count].code_length = code_lengths[i];
+        symbols[count].code = codes[i];
+        count++;
+    }
+    
+    return count;
+}
@@ -0,0 +1,68 @@
+#include "file_map.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int file_map_open_read(const char* path, file_map_t* map) {
+    if (!path || !map) return -1;
+    
+    map->data = NULL;
+    map->size = 0;
+    map->fd = open(path, O_RDONLY);
+    if (map->fd < 0) return -1;
+    
+    struct stat st;
+    if (fstat(map->fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > SIZE_MAX) {
+        close(map->fd);
+        return -1;
+    }
+    
+    map->size = (size_t)st.st_size;
+    if (map->size == 0) return 0;
+    
+    void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+    if (data == MAP_FAILED) {
+        close(map->fd);
+        return -1;
+    }
+    
+    // Read-ahead aggressively and drop pages soon after they are passed
+    madvise(data, map->size, MADV_SEQUENTIAL);
+    map->data = data;
+    return 0;
+}
+
+int file_map_create(const char* path, size_t size, file_map_t* map) {
+    if (!path || !map) return -1;
+    
+    map->data = NULL;
+    map->size = size;
+    map->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (map->fd < 0) return -1;
+    
+    if ((uint64_t)size > (uint64_t)INT64_MAX || ftruncate(map->fd, (off_t)size) != 0) {
+        close(map->fd);
+        return -1;
+    }
+    if (size == 0) return 0;
+    
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+    if (data == MAP_FAILED) {
+        close(map->fd);
+        return -1;
+    }
+    
+    map->data = data;
+    return 0;
+}
+
+void file_map_close(file_map_t* map) {
+    if (!map || map->fd < 0) return;
+    
+    if (map->data) munmap(map->data, map->size);
+    close(map->fd);
+    map->data = NULL;
+    map->size = 0;
+    map->fd = -1;
+}
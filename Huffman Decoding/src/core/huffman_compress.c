@@ -1,16 +1,25 @@
 #include "huffman_compress.h"
+#include "decoder_cache.h"
+#include "block_container.h"
+#include "file_map.h"
 #include <stdlib.h>
 #include <string.h>
 
+// Forward declarations for the decompression paths
+static int decompress_single(const uint8_t* compressed_data, size_t compressed_size, size_t padding,
+                             const symbol_info_t* symbol_table, size_t symbol_count,
+                             uint8_t** output_data, size_t* output_size, size_t expected_size);
+static int decompress_interleaved(const uint8_t* compressed_data, size_t compressed_size, size_t padding,
+                                  const symbol_info_t* symbol_table, size_t symbol_count,
+                                  uint8_t** output_data, size_t* output_size, size_t expected_size);
+
 huffman_context_t* huffman_context_create(void) {
     huffman_context_t* ctx = malloc(sizeof(huffman_context_t));
     if (!ctx) return NULL;
     
     ctx->freq_table = NULL;
     ctx->code_table = NULL;
-    ctx->tree_root = NULL;
     ctx->decode_tree = NULL;
-    ctx->writer = NULL;
     
     return ctx;
 }
@@ -20,44 +29,11 @@ void huffman_context_destroy(huffman_context_t* ctx) {
     
     if (ctx->freq_table) frequency_table_destroy(ctx->freq_table);
     if (ctx->code_table) code_table_destroy(ctx->code_table);
-    if (ctx->tree_root) destroy_encoder_tree(ctx->tree_root);
     if (ctx->decode_tree) huffman_tree_destroy(ctx->decode_tree);
-    if (ctx->writer) bit_writer_destroy(ctx->writer);
     
     free(ctx);
 }
 
-static uint8_t* read_file_data(const char* path, size_t* size) {
-    FILE* file = fopen(path, "rb");
-    if (!file) return NULL;
-    
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    if (file_size <= 0) {
-        fclose(file);
-        return NULL;
-    }
-    
-    uint8_t* data = malloc(file_size);
-    if (!data) {
-        fclose(file);
-        return NULL;
-    }
-    
-    size_t read_size = fread(data, 1, file_size, file);
-    fclose(file);
-    
-    if (read_size != (size_t)file_size) {
-        free(data);
-        return NULL;
-    }
-    
-    *size = file_size;
-    return data;
-}
-
 static int write_file_data(const char* path, const uint8_t* data, size_t size) {
     FILE* file = fopen(path, "wb");
     if (!file) return -1;
@@ -68,34 +44,37 @@ static int write_file_data(const char* path, const uint8_t* data, size_t size) {
     return (written == size) ? 0 : -1;
 }
 
-int huffman_compress_data(const uint8_t* data, size_t data_size, 
-                         uint8_t** compressed_data, size_t* compressed_size,
-                         symbol_info_t** symbol_table, size_t* symbol_count) {
-    if (!data || !compressed_data || !compressed_size || !symbol_table || !symbol_count) {
-        return -1;
-    }
-    
+// Longest code the options allow
+static uint8_t options_max_code_length(const huffman_compress_options_t* options) {
+    if (!options || options->max_code_length == 0) return MAX_CODE_LENGTH;
+    return options->max_code_length;
+}
+
+// Analyze frequencies, build canonical codes and the output symbol table.
+// Returns a context holding the frequency and code tables.
+static huffman_context_t* prepare_codes(const uint8_t* data, size_t data_size, uint8_t max_code_length,
+                                        symbol_info_t** symbol_table, size_t* symbol_count) {
     huffman_context_t* ctx = huffman_context_create();
-    if (!ctx) return -1;
+    if (!ctx) return NULL;
     
     // Analyze frequencies
     ctx->freq_table = frequency_table_create();
     if (!ctx->freq_table || frequency_table_analyze(ctx->freq_table, data, data_size) != 0) {
         huffman_context_destroy(ctx);
-        return -1;
+        return NULL;
     }
     
-    // Build tree and generate codes
-    ctx->tree_root = build_huffman_tree(ctx->freq_table);
-    if (!ctx->tree_root) {
+    // Code lengths, then canonical codes for them
+    uint8_t code_lengths[MAX_SYMBOLS];
+    if (build_limited_code_lengths(ctx->freq_table, max_code_length, code_lengths) != 0) {
         huffman_context_destroy(ctx);
-        return -1;
+        return NULL;
     }
     
-    ctx->code_table = generate_codes(ctx->tree_root);
+    ctx->code_table = code_table_from_lengths(code_lengths);
     if (!ctx->code_table) {
         huffman_context_destroy(ctx);
-        return -1;
+        return NULL;
     }
     
     // Create symbol table for output
@@ -103,7 +82,7 @@ int huffman_compress_data(const uint8_t* data, size_t data_size,
     *symbol_table = malloc(sizeof(symbol_info_t) * (*symbol_count));
     if (!*symbol_table) {
         huffman_context_destroy(ctx);
-        return -1;
+        return NULL;
     }
     
     size_t table_index = 0;
@@ -116,137 +95,300 @@ int huffman_compress_data(const uint8_t* data, size_t data_size,
         }
     }
     
-    // Encode data
-    ctx->writer = bit_writer_create();
-    if (!ctx->writer) {
-        free(*symbol_table);
-        huffman_context_destroy(ctx);
-        return -1;
+    return ctx;
+}
+
+// The exact encoded size, one padding byte per extra stream, the jump table
+// and the word-store slack
+size_t huffman_payload_capacity(const code_table_t* code_table, const frequency_table_t* freq_table,
+                                int interleaved) {
+    uint64_t bits = code_table_encoded_bits(code_table, freq_table);
+    size_t capacity = (size_t)((bits + 7) / 8) + ENCODE_OUTPUT_SLACK;
+    
+    if (interleaved) {
+        capacity += HUFFMAN_JUMP_TABLE_SIZE + HUFFMAN_INTERLEAVE_STREAMS - 1;
+    }
+    return capacity;
+}
+
+int huffman_encode_payload(const code_table_t* code_table, const uint8_t* data, size_t data_size,
+                           int interleaved, uint8_t* output, size_t* compressed_size) {
+    if (!interleaved) {
+        *compressed_size = huffman_encode_into(code_table, data, data_size, output);
+        return 0;
     }
     
-    for (size_t i = 0; i < data_size; i++) {
-        if (bit_writer_write_code(ctx->writer, &ctx->code_table->codes[data[i]]) != 0) {
-            free(*symbol_table);
-            huffman_context_destroy(ctx);
-            return -1;
+    // Each segment ends byte-aligned, so the bytes each one takes are the
+    // stream sizes for the jump table
+    const size_t segment = huffman_interleave_segment(data_size);
+    uint32_t jump_table[HUFFMAN_INTERLEAVE_STREAMS - 1];
+    uint8_t* out = output + HUFFMAN_JUMP_TABLE_SIZE;
+    size_t start = 0;
+    
+    for (int k = 0; k < HUFFMAN_INTERLEAVE_STREAMS; k++) {
+        size_t length = (data_size - start < segment) ? data_size - start : segment;
+        size_t bytes = huffman_encode_into(code_table, data + start, length, out);
+        start += length;
+        out += bytes;
+        
+        if (k < HUFFMAN_INTERLEAVE_STREAMS - 1) {
+            if (bytes > UINT32_MAX) return -1;
+            jump_table[k] = (uint32_t)bytes;
         }
     }
     
-    if (bit_writer_flush(ctx->writer) != 0) {
-        free(*symbol_table);
-        huffman_context_destroy(ctx);
-        return -1;
+    memcpy(output, jump_table, HUFFMAN_JUMP_TABLE_SIZE);
+    *compressed_size = (size_t)(out - output);
+    return 0;
+}
+
+size_t huffman_compress_bound(size_t data_size) {
+    const size_t overhead = HUFFMAN_JUMP_TABLE_SIZE + HUFFMAN_INTERLEAVE_STREAMS - 1 + ENCODE_OUTPUT_SLACK;
+    const size_t max_code_bytes = (MAX_CODE_LENGTH + 7) / 8;
+    
+    if (data_size > (SIZE_MAX - overhead) / max_code_bytes) return 0;
+    return data_size * max_code_bytes + overhead;
+}
+
+// Shared by the allocating and caller-buffer entry points: output NULL
+// means allocate exactly what the codes need
+static int compress_data(const uint8_t* data, size_t data_size, const huffman_compress_options_t* options,
+                         int interleaved, uint8_t** compressed_data, size_t output_capacity,
+                         size_t* compressed_size, symbol_info_t** symbol_table, size_t* symbol_count) {
+    huffman_context_t* ctx = prepare_codes(data, data_size, options_max_code_length(options),
+                                           symbol_table, symbol_count);
+    if (!ctx) return -1;
+    
+    size_t capacity = huffman_payload_capacity(ctx->code_table, ctx->freq_table, interleaved);
+    uint8_t* output = *compressed_data;
+    if (!output) {
+        output = malloc(capacity);
+    } else if (output_capacity < capacity) {
+        output = NULL;
     }
     
-    // Get compressed data
-    uint8_t* writer_data = bit_writer_get_data(ctx->writer, compressed_size);
-    *compressed_data = malloc(*compressed_size);
-    if (!*compressed_data) {
+    if (!output || huffman_encode_payload(ctx->code_table, data, data_size, interleaved,
+                                          output, compressed_size) != 0) {
+        if (output && output != *compressed_data) free(output);
         free(*symbol_table);
         huffman_context_destroy(ctx);
         return -1;
     }
     
-    memcpy(*compressed_data, writer_data, *compressed_size);
+    *compressed_data = output;
     huffman_context_destroy(ctx);
     return 0;
 }
 
+int huffman_compress_data(const uint8_t* data, size_t data_size, 
+                         uint8_t** compressed_data, size_t* compressed_size,
+                         symbol_info_t** symbol_table, size_t* symbol_count) {
+    return huffman_compress_data_with_options(data, data_size, NULL, compressed_data, compressed_size,
+                                              symbol_table, symbol_count);
+}
+
+int huffman_compress_data_with_options(const uint8_t* data, size_t data_size,
+                                       const huffman_compress_options_t* options,
+                                       uint8_t** compressed_data, size_t* compressed_size,
+                                       symbol_info_t** symbol_table, size_t* symbol_count) {
+    if (!data || !compressed_data || !compressed_size || !symbol_table || !symbol_count) {
+        return -1;
+    }
+    
+    *compressed_data = NULL;
+    return compress_data(data, data_size, options, 0, compressed_data, 0,
+                         compressed_size, symbol_table, symbol_count);
+}
+
+int huffman_compress_data_interleaved(const uint8_t* data, size_t data_size,
+                                     uint8_t** compressed_data, size_t* compressed_size,
+                                     symbol_info_t** symbol_table, size_t* symbol_count) {
+    return huffman_compress_data_interleaved_with_options(data, data_size, NULL, compressed_data,
+                                                          compressed_size, symbol_table, symbol_count);
+}
+
+int huffman_compress_data_interleaved_with_options(const uint8_t* data, size_t data_size,
+                                                   const huffman_compress_options_t* options,
+                                                   uint8_t** compressed_data, size_t* compressed_size,
+                                                   symbol_info_t** symbol_table, size_t* symbol_count) {
+    if (!data || !compressed_data || !compressed_size || !symbol_table || !symbol_count) {
+        return -1;
+    }
+    
+    *compressed_data = NULL;
+    return compress_data(data, data_size, options, 1, compressed_data, 0,
+                         compressed_size, symbol_table, symbol_count);
+}
+
+int huffman_compress_data_into(const uint8_t* data, size_t data_size,
+                               const huffman_compress_options_t* options,
+                               uint8_t* output, size_t output_capacity, size_t* compressed_size,
+                               symbol_info_t** symbol_table, size_t* symbol_count) {
+    if (!data || !output || !compressed_size || !symbol_table || !symbol_count) {
+        return -1;
+    }
+    
+    return compress_data(data, data_size, options, 0, &output, output_capacity,
+                         compressed_size, symbol_table, symbol_count);
+}
+
+int huffman_compress_data_interleaved_into(const uint8_t* data, size_t data_size,
+                                           const huffman_compress_options_t* options,
+                                           uint8_t* output, size_t output_capacity, size_t* compressed_size,
+                                           symbol_info_t** symbol_table, size_t* symbol_count) {
+    if (!data || !output || !compressed_size || !symbol_table || !symbol_count) {
+        return -1;
+    }
+    
+    return compress_data(data, data_size, options, 1, &output, output_capacity,
+                         compressed_size, symbol_table, symbol_count);
+}
+
 int huffman_compress_file(const char* input_path, const char* output_path) {
+    return huffman_compress_file_with_options(input_path, output_path, NULL);
+}
+
+int huffman_compress_file_with_options(const char* input_path, const char* output_path,
+                                       const huffman_compress_options_t* options) {
     if (!input_path || !output_path) return -1;
     
-    // Read input file
-    size_t data_size;
-    uint8_t* data = read_file_data(input_path, &data_size);
-    if (!data) return -1;
+    // Map the input; the block encoder reads it straight from the page cache
+    file_map_t input;
+    if (file_map_open_read(input_path, &input) != 0) return -1;
     
-    // Compress data
-    uint8_t* compressed_data;
-    size_t compressed_size;
-    symbol_info_t* symbol_table;
-    size_t symbol_count;
+    // Version 2 container: independent blocks, each with its own table
+    const size_t data_size = input.size;
+    uint8_t* container;
+    size_t container_size;
+    int result = huffman_compress_blocks(input.data, data_size, options, &container, &container_size);
+    file_map_close(&input);
+    if (result != 0) return -1;
     
-    int result = huffman_compress_data(data, data_size, &compressed_data, &compressed_size,
-                                      &symbol_table, &symbol_count);
-    if (result != 0) {
-        free(data);
+    result = write_file_data(output_path, container, container_size);
+    free(container);
+    if (result != 0) return -1;
+    
+    printf("Compression completed successfully!\n");
+    print_compression_stats(data_size, container_size);
+    
+    return 0;
+}
+
+int huffman_compress_file_streaming(const char* input_path, const char* output_path,
+                                    const huffman_compress_options_t* options) {
+    if (!input_path || !output_path) return -1;
+    
+    FILE* input = fopen(input_path, "rb");
+    if (!input) return -1;
+    
+    FILE* output = fopen(output_path, "wb");
+    if (!output) {
+        fclose(input);
         return -1;
     }
     
-    // Create header
-    huffman_header_t header = {0};
-    header.magic = HUFFMAN_MAGIC;
-    header.version = HUFFMAN_VERSION;
-    header.flags = 0;
-    header.original_size = data_size;
-    header.compressed_size = compressed_size;
-    header.symbol_count = symbol_count;
-    header.max_code_length = 0;
-    header.checksum = calculate_crc32(data, data_size);
-    
-    // Find max code length
-    for (size_t i = 0; i < symbol_count; i++) {
-        if (symbol_table[i].code_length > header.max_code_length) {
-            header.max_code_length = symbol_table[i].code_length;
-        }
-    }
+    uint64_t original_size, compressed_size;
+    int result = huffman_compress_stream(input, output, options, &original_size, &compressed_size);
+    fclose(input);
+    if (fclose(output) != 0) result = -1;
     
-    // Write output file
-    FILE* output_file = fopen(output_path, "wb");
-    if (!output_file) {
-        free(data);
-        free(compressed_data);
-        free(symbol_table);
+    if (result != 0) {
+        remove(output_path);
         return -1;
     }
     
-    // Write header, symbol table, and compressed data
-    if (huffman_write_header(output_file, &header) != 0 ||
-        huffman_write_symbol_table(output_file, symbol_table, symbol_count) != 0 ||
-        fwrite(compressed_data, 1, compressed_size, output_file) != compressed_size) {
-        fclose(output_file);
-        free(data);
-        free(compressed_data);
-        free(symbol_table);
+    printf("Compression completed successfully!\n");
+    print_compression_stats(original_size, compressed_size);
+    
+    return 0;
+}
+
+int huffman_decompress_file_streaming(const char* input_path, const char* output_path) {
+    if (!input_path || !output_path) return -1;
+    
+    FILE* input = fopen(input_path, "rb");
+    if (!input) return -1;
+    
+    FILE* output = fopen(output_path, "wb");
+    if (!output) {
+        fclose(input);
         return -1;
     }
     
-    fclose(output_file);
-    free(data);
-    free(compressed_data);
-    free(symbol_table);
+    int result = huffman_decompress_stream(input, output, NULL);
+    fclose(input);
+    if (fclose(output) != 0) result = -1;
     
-    printf("Compression completed successfully!\n");
-    print_compression_stats(data_size, sizeof(huffman_header_t) + 
-                           sizeof(symbol_info_t) * symbol_count + compressed_size);
+    if (result != 0) {
+        remove(output_path);
+        return -1;
+    }
     
+    printf("Decompression completed successfully!\n");
     return 0;
 }
 
-int huffman_decompress_file(const char* input_path, const char* output_path) {
-    if (!input_path || !output_path) return -1;
+int huffman_decompress_file_range(const char* input_path, FILE* output, uint64_t start, uint64_t end) {
+    if (!input_path || !output) return -1;
     
-    FILE* input_file = fopen(input_path, "rb");
-    if (!input_file) return -1;
+    file_map_t input;
+    if (file_map_open_read(input_path, &input) != 0) return -1;
     
-    // Read header
-    huffman_header_t header;
-    if (huffman_read_header(input_file, &header) != 0) {
-        fclose(input_file);
+    huffman_block_index_t index;
+    if (huffman_read_block_index(input.data, input.size, &index) != 0) {
+        file_map_close(&input);
         return -1;
     }
+    if (end > index.header.original_size) end = index.header.original_size;
+    
+    // Written in pieces that stop at block boundaries, so one block of
+    // buffer covers a range of any length
+    const uint32_t block_size = index.trailer.block_size;
+    uint8_t* buffer = malloc(block_size);
+    int result = (buffer && start <= end) ? 0 : -1;
+    for (uint64_t piece = start; result == 0 && piece < end;) {
+        uint64_t piece_end = (piece / block_size + 1) * block_size;
+        if (piece_end > end) piece_end = end;
+        
+        const size_t length = (size_t)(piece_end - piece);
+        if (huffman_decode_range(input.data, &index, piece, piece_end, buffer) != 0 ||
+            fwrite(buffer, 1, length, output) != length) {
+            result = -1;
+        }
+        piece = piece_end;
+    }
     
+    free(buffer);
+    file_map_close(&input);
+    return result;
+}
+
+// Version 1 file: one symbol table and one bit stream after the header
+static int decompress_file_single(FILE* input_file, const huffman_header_t* header,
+                                  const char* output_path) {
     // Read symbol table
-    symbol_info_t* symbol_table = malloc(sizeof(symbol_info_t) * header.symbol_count);
-    if (!symbol_table || huffman_read_symbol_table(input_file, symbol_table, header.symbol_count) != 0) {
+    symbol_info_t* symbol_table = malloc(sizeof(symbol_info_t) * header->symbol_count);
+    if (!symbol_table || huffman_read_symbol_table(input_file, symbol_table, header->symbol_count) != 0) {
         fclose(input_file);
         if (symbol_table) free(symbol_table);
         return -1;
     }
     
-    // Read compressed data
-    uint8_t* compressed_data = malloc(header.compressed_size);
-    if (!compressed_data || fread(compressed_data, 1, header.compressed_size, input_file) != header.compressed_size) {
+    // No code may run past the length limit the header promises
+    for (size_t i = 0; i < header->symbol_count; i++) {
+        if (symbol_table[i].code_length > header->max_code_length) {
+            fclose(input_file);
+            free(symbol_table);
+            return -1;
+        }
+    }
+    
+    // Read compressed data, followed by zeroed padding for the fast bit reader
+    uint8_t* compressed_data = malloc(header->compressed_size + BIT_STREAM_PADDING);
+    if (compressed_data) {
+        memset(compressed_data + header->compressed_size, 0, BIT_STREAM_PADDING);
+    }
+    if (!compressed_data || fread(compressed_data, 1, header->compressed_size, input_file) != header->compressed_size) {
         fclose(input_file);
         free(symbol_table);
         if (compressed_data) free(compressed_data);
@@ -259,9 +401,16 @@ int huffman_decompress_file(const char* input_path, const char* output_path) {
     uint8_t* output_data;
     size_t output_size;
     
-    int result = huffman_decompress_data(compressed_data, header.compressed_size,
-                                        symbol_table, header.symbol_count,
-                                        &output_data, &output_size, header.original_size);
+    int result;
+    if (header->flags & HUFFMAN_FLAG_INTERLEAVED) {
+        result = decompress_interleaved(compressed_data, header->compressed_size, BIT_STREAM_PADDING,
+                                        symbol_table, header->symbol_count,
+                                        &output_data, &output_size, header->original_size);
+    } else {
+        result = decompress_single(compressed_data, header->compressed_size, BIT_STREAM_PADDING,
+                                   symbol_table, header->symbol_count,
+                                   &output_data, &output_size, header->original_size);
+    }
     
     free(compressed_data);
     free(symbol_table);
@@ -269,13 +418,13 @@ int huffman_decompress_file(const char* input_path, const char* output_path) {
     if (result != 0) return -1;
     
     // Verify size and checksum
-    if (output_size != header.original_size) {
+    if (output_size != header->original_size) {
         free(output_data);
         return -1;
     }
     
     uint32_t checksum = calculate_crc32(output_data, output_size);
-    if (checksum != header.checksum) {
+    if (checksum != header->checksum) {
         free(output_data);
         return -1;
     }
@@ -291,88 +440,201 @@ int huffman_decompress_file(const char* input_path, const char* output_path) {
     return result;
 }
 
-int huffman_decompress_data(const uint8_t* compressed_data, size_t compressed_size,
-                           const symbol_info_t* symbol_table, size_t symbol_count,
-                           uint8_t** output_data, size_t* output_size, size_t expected_size) {
-    if (!compressed_data || !symbol_table || !output_data || !output_size) {
+int huffman_decompress_file(const char* input_path, const char* output_path) {
+    return huffman_decompress_file_with_options(input_path, output_path, NULL);
+}
+
+int huffman_decompress_file_with_options(const char* input_path, const char* output_path,
+                                         const huffman_decompress_options_t* options) {
+    if (!input_path || !output_path) return -1;
+    
+    FILE* input_file = fopen(input_path, "rb");
+    if (!input_file) return -1;
+    
+    // Read header
+    huffman_header_t header;
+    if (huffman_read_header(input_file, &header) != 0) {
+        fclose(input_file);
         return -1;
     }
     
-    // Convert symbol table to arrays for tree building
-    uint8_t* symbols = malloc(symbol_count);
-    uint8_t* code_lengths = malloc(symbol_count);
-    uint32_t* codes = malloc(symbol_count * sizeof(uint32_t));
+    if (header.version == HUFFMAN_VERSION_SINGLE) {
+        return decompress_file_single(input_file, &header, output_path);
+    }
+    fclose(input_file);
+    
+    // Version 2: map the container, whose index sits at the end, and decode
+    // into the mapped output file
+    file_map_t input;
+    if (file_map_open_read(input_path, &input) != 0) return -1;
+    
+    huffman_block_index_t index;
+    if (huffman_read_block_index(input.data, input.size, &index) != 0 ||
+        index.header.original_size > SIZE_MAX) {
+        file_map_close(&input);
+        return -1;
+    }
     
-    if (!symbols || !code_lengths || !codes) {
-        if (symbols) free(symbols);
-        if (code_lengths) free(code_lengths);
-        if (codes) free(codes);
+    file_map_t output;
+    if (file_map_create(output_path, (size_t)index.header.original_size, &output) != 0) {
+        file_map_close(&input);
         return -1;
     }
     
-    for (size_t i = 0; i < symbol_count; i++) {
-        symbols[i] = symbol_table[i].symbol;
-        code_lengths[i] = symbol_table[i].code_length;
-        codes[i] = symbol_table[i].code;
+    int result = huffman_decode_blocks(input.data, &index, options ? options->threads : 0, output.data);
+    file_map_close(&input);
+    file_map_close(&output);
+    
+    if (result != 0) {
+        remove(output_path);
+        return -1;
+    }
+    
+    printf("Decompression completed successfully!\n");
+    return 0;
+}
+
+// Decode exactly output_size bytes into the caller's buffer. The decoder
+// comes from the table cache and the bit stream lives on the stack, so a
+// cached table means no heap allocation at all. `padding` readable bytes
+// after the compressed data let the fast bit reader run to the very end of
+// the stream.
+static int decode_single_into(const uint8_t* compressed_data, size_t compressed_size, size_t padding,
+                              const symbol_info_t* symbol_table, size_t symbol_count,
+                              uint8_t* output, size_t output_size) {
+    if (!compressed_data || !symbol_table || (!output && output_size > 0)) {
+        return -1;
     }
     
-    // Build decode tree using actual codes
-    huffman_tree_t* tree = huffman_tree_from_code_table(symbols, codes, code_lengths, symbol_count);
-    free(symbols);
-    free(code_lengths);
-    free(codes);
+    // Shared decoder for this symbol table, built only on a cache miss
+    decoder_cache_entry_t* cached = decoder_cache_acquire(symbol_table, symbol_count, output_size);
+    if (!cached) return -1;
     
-    if (!tree) return -1;
+    bit_stream_t stream;
+    bit_stream_init(&stream, compressed_data, compressed_size, padding);
     
-    // Create bit stream and decoder
-    bit_stream_t* stream = bit_stream_create((uint8_t*)compressed_data, compressed_size);
-    huffman_decoder_t* decoder = huffman_decoder_create(tree);
+    // Decode exactly the expected number of bytes through the lookup table
+    size_t decoded = huffman_decode_symbols(cached->decoder, &stream, output, output_size);
+    decoder_cache_release(cached);
     
-    if (!stream || !decoder) {
-        if (stream) bit_stream_destroy(stream);
-        if (decoder) huffman_decoder_destroy(decoder);
-        huffman_tree_destroy(tree);
+    return decoded == output_size ? 0 : -1;
+}
+
+static int decode_interleaved_into(const uint8_t* compressed_data, size_t compressed_size, size_t padding,
+                                   const symbol_info_t* symbol_table, size_t symbol_count,
+                                   uint8_t* output, size_t output_size) {
+    if (!compressed_data || !symbol_table || (!output && output_size > 0)) {
         return -1;
     }
     
+    // Locate the four streams through the jump table
+    if (compressed_size < HUFFMAN_JUMP_TABLE_SIZE) return -1;
+    
+    uint32_t jump_table[HUFFMAN_INTERLEAVE_STREAMS - 1];
+    memcpy(jump_table, compressed_data, HUFFMAN_JUMP_TABLE_SIZE);
+    
+    size_t stream_offset[HUFFMAN_INTERLEAVE_STREAMS];
+    size_t stream_size[HUFFMAN_INTERLEAVE_STREAMS];
+    size_t offset = HUFFMAN_JUMP_TABLE_SIZE;
+    
+    for (int k = 0; k < HUFFMAN_INTERLEAVE_STREAMS - 1; k++) {
+        if (jump_table[k] > compressed_size - offset) return -1;
+        stream_offset[k] = offset;
+        stream_size[k] = jump_table[k];
+        offset += jump_table[k];
+    }
+    stream_offset[HUFFMAN_INTERLEAVE_STREAMS - 1] = offset;
+    stream_size[HUFFMAN_INTERLEAVE_STREAMS - 1] = compressed_size - offset;
+    
+    decoder_cache_entry_t* cached = decoder_cache_acquire(symbol_table, symbol_count, output_size);
+    if (!cached) return -1;
+    
+    // Each stream can read on into the next one, the last into the padding
+    bit_stream_t lanes[HUFFMAN_INTERLEAVE_STREAMS];
+    bit_stream_t* streams[HUFFMAN_INTERLEAVE_STREAMS];
+    for (int k = 0; k < HUFFMAN_INTERLEAVE_STREAMS; k++) {
+        size_t stream_end = stream_offset[k] + stream_size[k];
+        size_t readable = compressed_size - stream_end + padding;
+        bit_stream_init(&lanes[k], compressed_data + stream_offset[k], stream_size[k],
+                        readable < BIT_STREAM_PADDING ? readable : BIT_STREAM_PADDING);
+        streams[k] = &lanes[k];
+    }
+    
+    int result = huffman_decode_interleaved(cached->decoder, streams, output, output_size);
+    decoder_cache_release(cached);
+    
+    return result;
+}
+
+static int decompress_single(const uint8_t* compressed_data, size_t compressed_size, size_t padding,
+                             const symbol_info_t* symbol_table, size_t symbol_count,
+                             uint8_t** output_data, size_t* output_size, size_t expected_size) {
+    if (!output_data || !output_size) return -1;
+    
     // Allocate output buffer for exact expected size
     uint8_t* temp_output = malloc(expected_size);
-    if (!temp_output) {
-        bit_stream_destroy(stream);
-        huffman_decoder_destroy(decoder);
-        huffman_tree_destroy(tree);
+    if (!temp_output) return -1;
+    
+    if (decode_single_into(compressed_data, compressed_size, padding, symbol_table, symbol_count,
+                           temp_output, expected_size) != 0) {
+        free(temp_output);
         return -1;
     }
     
-    // Decode exactly the expected number of bytes
-    size_t temp_size = 0;
-    while (temp_size < expected_size && bit_stream_has_data(stream)) {
-        uint8_t symbol;
-        if (huffman_decode_symbol(tree, stream, &symbol) != 0) {
-            break;  // End of valid data or error
-        }
-        
-        temp_output[temp_size++] = symbol;
-    }
+    *output_data = temp_output;
+    *output_size = expected_size;
     
-    // Cleanup
-    bit_stream_destroy(stream);
-    huffman_decoder_destroy(decoder);
-    huffman_tree_destroy(tree);
+    return 0;
+}
+
+static int decompress_interleaved(const uint8_t* compressed_data, size_t compressed_size, size_t padding,
+                                  const symbol_info_t* symbol_table, size_t symbol_count,
+                                  uint8_t** output_data, size_t* output_size, size_t expected_size) {
+    if (!output_data || !output_size) return -1;
     
-    // Check if we decoded the expected amount
-    if (temp_size != expected_size) {
+    uint8_t* temp_output = malloc(expected_size);
+    if (!temp_output) return -1;
+    
+    if (decode_interleaved_into(compressed_data, compressed_size, padding, symbol_table, symbol_count,
+                                temp_output, expected_size) != 0) {
         free(temp_output);
         return -1;
     }
     
-    // Return results
     *output_data = temp_output;
-    *output_size = temp_size;
+    *output_size = expected_size;
     
     return 0;
 }
 
+int huffman_decompress_data(const uint8_t* compressed_data, size_t compressed_size,
+                           const symbol_info_t* symbol_table, size_t symbol_count,
+                           uint8_t** output_data, size_t* output_size, size_t expected_size) {
+    return decompress_single(compressed_data, compressed_size, 0, symbol_table, symbol_count,
+                             output_data, output_size, expected_size);
+}
+
+int huffman_decompress_data_interleaved(const uint8_t* compressed_data, size_t compressed_size,
+                                       const symbol_info_t* symbol_table, size_t symbol_count,
+                                       uint8_t** output_data, size_t* output_size, size_t expected_size) {
+    return decompress_interleaved(compressed_data, compressed_size, 0, symbol_table, symbol_count,
+                                  output_data, output_size, expected_size);
+}
+
+int huffman_decompress_data_into(const uint8_t* compressed_data, size_t compressed_size,
+                                 const symbol_info_t* symbol_table, size_t symbol_count,
+                                 uint8_t* output, size_t output_size) {
+    return decode_single_into(compressed_data, compressed_size, 0, symbol_table, symbol_count,
+                              output, output_size);
+}
+
+int huffman_decompress_data_interleaved_into(const uint8_t* compressed_data, size_t compressed_size,
+                                             const symbol_info_t* symbol_table, size_t symbol_count,
+                                             uint8_t* output, size_t output_size) {
+    return decode_interleaved_into(compressed_data, compressed_size, 0, symbol_table, symbol_count,
+                                   output, output_size);
+}
+
 void print_compression_stats(size_t original_size, size_t compressed_size) {
     if (original_size == 0) {
         printf("Original size: 0 bytes\n");
@@ -47,11 +47,21 @@ huffman_tree_t* huffman_tree_from_codes(uint8_t* symbols, uint8_t* code_lengths,
         return NULL;
     }
     
+    // Entries come in canonical (length, symbol) order: the next code is the
+    // previous one plus one, shifted left whenever the length grows
     uint32_t code = 0;
+    uint8_t previous_length = 0;
     
     for (size_t i = 0; i < count; i++) {
         if (code_lengths[i] == 0) continue;
         
+        if (previous_length == 0) {
+            code = 0;
+        } else {
+            code <<= code_lengths[i] - previous_length;
+        }
+        previous_length = code_lengths[i];
+        
         huffman_node_t* current = tree->root;
         
         for (int bit = code_lengths[i] - 1; bit >= 0; bit--) {
@@ -0,0 +1,269 @@
+#include "decoder.h"
+#include "encoder.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Two-level lookup table construction shared by the decoder variants.
+//
+// Codes up to direct_bits long are resolved by the first-level table alone.
+// Every direct_bits prefix that leads to longer codes gets a second-level
+// subtable sized for the longest code under that prefix, so any code up to
+// MAX_CODE_LENGTH bits decodes in at most two table probes.
+
+typedef struct table_leaf {
+    uint32_t code;
+    uint8_t symbol;
+    uint8_t length;
+} table_leaf_t;
+
+// Collect (symbol, code, length) for every leaf of the decode tree
+static int collect_leaves(huffman_node_t* node, uint32_t code, uint8_t depth,
+                          table_leaf_t* leaves, size_t* count) {
+    if (!node) return 0;
+    
+    if (node->is_leaf) {
+        if (depth == 0 || depth > MAX_CODE_LENGTH || *count >= MAX_SYMBOLS) return -1;
+        leaves[*count].code = code;
+        leaves[*count].symbol = node->symbol;
+        leaves[*count].length = depth;
+        (*count)++;
+        return 0;
+    }
+    
+    if (depth >= MAX_CODE_LENGTH) return -1;
+    
+    if (collect_leaves(node->left, code << 1, depth + 1, leaves, count) != 0) return -1;
+    return collect_leaves(node->right, (code << 1) | 1, depth + 1, leaves, count);
+}
+
+static void fill_entries(lookup_entry_t* table, uint32_t first, uint32_t num_entries,
+                         uint8_t symbol, uint8_t code_length) {
+    const lookup_entry_t entry = { .symbol = symbol, .code_length = code_length };
+    for (uint32_t i = 0; i < num_entries; i++) {
+        table[first + i] = entry;
+    }
+}
+
+static int build_tables(vectorized_lookup_table_t* table, const table_leaf_t* leaves, size_t count) {
+    const uint8_t direct_bits = table->direct_bits;
+    
+    // Width of the subtable needed under each direct_bits prefix (0 = none),
+    // plus the list of prefixes that need one (at most one per long code)
+    uint8_t* subtable_bits = calloc(table->direct_size, 1);
+    if (!subtable_bits) return -1;
+    
+    uint32_t long_prefixes[MAX_SYMBOLS];
+    size_t num_prefixes = 0;
+    uint8_t max_extra = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        const table_leaf_t* leaf = &leaves[i];
+        
+        if (leaf->length > table->max_code_length) {
+            table->max_code_length = leaf->length;
+        }
+        
+        if (leaf->length <= direct_bits) {
+            uint32_t shift = direct_bits - leaf->length;
+            fill_entries(table->direct_table, leaf->code << shift, 1U << shift,
+                         leaf->symbol, leaf->length);
+        } else {
+            uint8_t extra = leaf->length - direct_bits;
+            uint32_t prefix = leaf->code >> extra;
+            if (subtable_bits[prefix] == 0) {
+                long_prefixes[num_prefixes++] = prefix;
+            }
+            if (extra > subtable_bits[prefix]) {
+                subtable_bits[prefix] = extra;
+            }
+            if (extra > max_extra) {
+                max_extra = extra;
+            }
+        }
+    }
+    
+    // Lay subtables out narrowest first, each aligned to its own size. The
+    // offset of subtable j is then at most j << bits, so (offset >> bits)
+    // always fits in the 8-bit symbol field of the first-level entry.
+    size_t overflow_end = 0;
+    for (uint8_t bits = 1; bits <= max_extra; bits++) {
+        for (size_t i = 0; i < num_prefixes; i++) {
+            uint32_t prefix = long_prefixes[i];
+            if (subtable_bits[prefix] != bits) continue;
+            
+            size_t size = (size_t)1 << bits;
+            size_t offset = (overflow_end + size - 1) & ~(size - 1);
+            if ((offset >> bits) > 0xFF) {
+                free(subtable_bits);
+                return -1;
+            }
+            
+            table->direct_table[prefix].symbol = (uint8_t)(offset >> bits);
+            table->direct_table[prefix].code_length = LOOKUP_SUBTABLE | bits;
+            overflow_end = offset + size;
+        }
+    }
+    
+    if (overflow_end > 0) {
+        size_t bytes = overflow_end * sizeof(lookup_entry_t);
+        table->overflow_table = aligned_alloc(64, (bytes + 63) & ~(size_t)63);
+        if (!table->overflow_table) {
+            free(subtable_bits);
+            return -1;
+        }
+        memset(table->overflow_table, 0, bytes);
+        table->overflow_size = overflow_end;
+        
+        for (size_t i = 0; i < count; i++) {
+            const table_leaf_t* leaf = &leaves[i];
+            if (leaf->length <= direct_bits) continue;
+            
+            uint8_t extra = leaf->length - direct_bits;
+            uint32_t prefix = leaf->code >> extra;
+            const lookup_entry_t* link = &table->direct_table[prefix];
+            uint8_t bits = LOOKUP_SUBTABLE_BITS(link->code_length);
+            uint32_t base = (uint32_t)link->symbol << bits;
+            uint32_t shift = bits - extra;
+            uint32_t suffix = leaf->code & ((1U << extra) - 1);
+            
+            fill_entries(table->overflow_table, base + (suffix << shift), 1U << shift,
+                         leaf->symbol, leaf->length);
+        }
+    }
+    
+    free(subtable_bits);
+    return 0;
+}
+
+static vectorized_lookup_table_t* create_from_leaves(const table_leaf_t* leaves, size_t count,
+                                                     uint8_t direct_bits) {
+    // The struct is declared 64-byte aligned, so plain malloc is not enough
+    vectorized_lookup_table_t* table = aligned_alloc(64, sizeof(vectorized_lookup_table_t));
+    if (!table) return NULL;
+    
+    table->direct_bits = direct_bits;
+    table->direct_size = 1U << direct_bits;
+    table->overflow_table = NULL;
+    table->multi_table = NULL;
+    table->overflow_size = 0;
+    table->max_code_length = 0;
+    
+    // One contiguous, cache-aligned array of 16-bit entries, all invalid
+    size_t bytes = table->direct_size * sizeof(lookup_entry_t);
+    table->direct_table = aligned_alloc(64, (bytes + 63) & ~(size_t)63);
+    if (!table->direct_table) {
+        free(table);
+        return NULL;
+    }
+    memset(table->direct_table, 0, bytes);
+    
+    if (build_tables(table, leaves, count) != 0) {
+        destroy_vectorized_lookup_table(table);
+        return NULL;
+    }
+    
+    return table;
+}
+
+vectorized_lookup_table_t* create_lookup_table_with_bits(huffman_tree_t* tree, uint8_t direct_bits) {
+    if (!tree || !tree->root || direct_bits == 0 || direct_bits > 16) return NULL;
+    
+    table_leaf_t leaves[MAX_SYMBOLS];
+    size_t count = 0;
+    if (collect_leaves(tree->root, 0, 0, leaves, &count) != 0) return NULL;
+    
+    return create_from_leaves(leaves, count, direct_bits);
+}
+
+// Same tables built straight from canonical code lengths, with no tree
+vectorized_lookup_table_t* create_lookup_table_from_lengths(const uint8_t* code_lengths, uint8_t direct_bits) {
+    if (!code_lengths || direct_bits == 0 || direct_bits > 16) return NULL;
+    
+    uint32_t codes[MAX_SYMBOLS];
+    if (canonical_codes_from_lengths(code_lengths, codes) != 0) return NULL;
+    
+    table_leaf_t leaves[MAX_SYMBOLS];
+    size_t count = 0;
+    for (int symbol = 0; symbol < MAX_SYMBOLS; symbol++) {
+        if (code_lengths[symbol] == 0) continue;
+        
+        leaves[count].code = codes[symbol];
+        leaves[count].symbol = (uint8_t)symbol;
+        leaves[count].length = code_lengths[symbol];
+        count++;
+    }
+    if (count == 0) return NULL;
+    
+    return create_from_leaves(leaves, count, direct_bits);
+}
+
+// Multi-symbol mode: for every direct_bits window, greedily decode whole
+// codes from the single-symbol direct table until the next code would run
+// past the window. Entries whose first code is longer than the window keep
+// a zero count and send the decoder back to the two-level path.
+int build_multi_symbol_table(vectorized_lookup_table_t* table) {
+    if (!table || !table->direct_table || table->direct_bits > 15) return -1;
+    if (table->multi_table) return 0;
+    
+    const uint8_t window = table->direct_bits;
+    const uint32_t mask = (uint32_t)table->direct_size - 1;
+    size_t bytes = table->direct_size * sizeof(multi_lookup_entry_t);
+    
+    multi_lookup_entry_t* multi = aligned_alloc(64, (bytes + 63) & ~(size_t)63);
+    if (!multi) return -1;
+    
+    uint8_t best_count = 0;
+    for (uint32_t index = 0; index < table->direct_size; index++) {
+        multi_lookup_entry_t entry = {{0, 0, 0}, 0};
+        uint8_t used = 0;
+        uint8_t count = 0;
+        
+        while (count < MULTI_LOOKUP_MAX_SYMBOLS) {
+            // Bits past the window read as zero; a match is only trusted
+            // when the whole code lies inside the window
+            lookup_entry_t next = table->direct_table[(index << used) & mask];
+            if (next.code_length == 0 || (next.code_length & LOOKUP_SUBTABLE) ||
+                next.code_length > window - used) {
+                break;
+            }
+            
+            entry.symbols[count++] = next.symbol;
+            used += next.code_length;
+        }
+        
+        entry.info = (uint8_t)((count << 4) | used);
+        multi[index] = entry;
+        if (count > best_count) best_count = count;
+    }
+    
+    // Codes too long for two to share a window (e.g. high-entropy input):
+    // the single-symbol path is just as fast, so don't attach the table
+    if (best_count < 2) {
+        free(multi);
+        return 0;
+    }
+    
+    table->multi_table = multi;
+    return 0;
+}
+
+vectorized_lookup_table_t* create_vectorized_lookup_table(huffman_tree_t* tree) {
+    // ITERATION 3: 12-bit direct lookup (4096 entries, 8KB)
+    return create_lookup_table_with_bits(tree, 12);
+}
+
+void destroy_vectorized_lookup_table(vectorized_lookup_table_t* table) {
+    if (!table) return;
+    
+    if (table->direct_table) {
+        free(table->direct_table);
+    }
+    if (table->overflow_table) {
+        free(table->overflow_table);
+    }
+    if (table->multi_table) {
+        free(table->multi_table);
+    }
+    
+    free(table);
+}
@@ -1,11 +1,16 @@
 #include "regression_test.h"
 #include "huffman_compress.h"
+#include "block_container.h"
+#include "cpu_dispatch.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
 // Fixed test suite - these tests never change
 const fixed_test_t FIXED_TESTS[] = {
@@ -436,4 +441,1099 @@ void save_regression_results(const regression_suite_t* suite, const char* filena
     fprintf(f, "}\n");
     
     fclose(f);
-}
\ No newline at end of file
+}
+
+// Correctness checks
+
+static int failed_checks;
+
+static void check(int passed, const char* name) {
+    if (!passed) {
+        printf("FAIL: %s\n", name);
+        failed_checks++;
+    }
+}
+
+// Deterministic inputs: uniform bytes, and a geometric spread over about
+// two dozen symbols whose rarest codes run past 20 bits
+static void fill_random(uint8_t* data, size_t size, uint32_t seed) {
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+static void fill_skewed(uint8_t* data, size_t size, uint32_t seed) {
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (uint8_t)('a' + __builtin_ctz((seed >> 8) | (1u << 23)));
+    }
+}
+
+// Once a table is cached, decoding into the caller's buffer touches no heap,
+// including for high-entropy tables whose multi-symbol table is not kept
+static void check_cached_decode_allocations(size_t (*allocation_count)(void)) {
+    const size_t size = 64 * 1024;
+    uint8_t* data = malloc(size);
+    uint8_t* output = malloc(size);
+    if (!data || !output) {
+        check(0, "cached decode: allocate inputs");
+        free(data);
+        free(output);
+        return;
+    }
+    
+    for (int pass = 0; pass < 4; pass++) {
+        const int interleaved = pass & 1;
+        if (pass < 2) {
+            fill_random(data, size, 1);
+        } else {
+            fill_skewed(data, size, 1);
+        }
+        
+        uint8_t* compressed;
+        size_t compressed_size;
+        symbol_info_t* symbol_table;
+        size_t symbol_count;
+        int result = interleaved
+            ? huffman_compress_data_interleaved(data, size, &compressed, &compressed_size, &symbol_table, &symbol_count)
+            : huffman_compress_data(data, size, &compressed, &compressed_size, &symbol_table, &symbol_count);
+        if (result != 0) {
+            check(0, "cached decode: compress");
+            continue;
+        }
+        
+        // The first decode builds and caches the decoder; the rest must not allocate
+        int decoded = 1;
+        size_t allocations = 0;
+        for (int i = 0; i < 16; i++) {
+            if (i == 1) allocations = allocation_count();
+            result = interleaved
+                ? huffman_decompress_data_interleaved_into(compressed, compressed_size, symbol_table, symbol_count,
+                                                           output, size)
+                : huffman_decompress_data_into(compressed, compressed_size, symbol_table, symbol_count,
+                                               output, size);
+            decoded &= result == 0 && memcmp(output, data, size) == 0;
+        }
+        
+        check(decoded, "cached decode: round trip");
+        check(allocation_count() == allocations, "cached decode: no allocations once cached");
+        free(compressed);
+        free(symbol_table);
+    }
+    
+    free(data);
+    free(output);
+}
+
+// The caller-owned decoder: one table built up front, then a stack
+// huffman_decoder_t and bit_stream_t per decode, with no heap use at all.
+// Covers direct-only codes, codes that need subtables, and the multi-symbol
+// table.
+static void check_stack_decoder(size_t (*allocation_count)(void)) {
+    const size_t size = 64 * 1024;
+    uint8_t* data = malloc(size);
+    uint8_t* output = malloc(size);
+    uint8_t* encoded = malloc(size * 4 + ENCODE_OUTPUT_SLACK);
+    if (!data || !output || !encoded) {
+        check(0, "stack decoder: allocate");
+        free(data);
+        free(output);
+        free(encoded);
+        return;
+    }
+    
+    for (int pass = 0; pass < 3; pass++) {
+        // Pass 0: every byte value at 8 bits. Passes 1 and 2: lengths 1..20
+        // and a second 20, so codes run past the 12-bit direct table.
+        uint8_t code_lengths[MAX_SYMBOLS] = {0};
+        if (pass == 0) {
+            memset(code_lengths, 8, sizeof(code_lengths));
+            fill_random(data, size, 11);
+        } else {
+            for (int i = 0; i < 20; i++) {
+                code_lengths[i] = (uint8_t)(i + 1);
+            }
+            code_lengths[20] = 20;
+            fill_random(data, size, 11);
+            for (size_t i = 0; i < size; i++) {
+                data[i] %= 21;
+            }
+        }
+        
+        code_table_t* code_table = code_table_from_lengths(code_lengths);
+        vectorized_lookup_table_t* table = create_lookup_table_from_lengths(code_lengths, 12);
+        if (!code_table || !table || (pass == 2 && build_multi_symbol_table(table) != 0)) {
+            check(0, "stack decoder: build tables");
+            if (code_table) code_table_destroy(code_table);
+            if (table) destroy_vectorized_lookup_table(table);
+            continue;
+        }
+        const size_t encoded_size = huffman_encode_into(code_table, data, size, encoded);
+        
+        int decoded = 1;
+        size_t allocations = allocation_count ? allocation_count() : 0;
+        for (int i = 0; i < 8; i++) {
+            huffman_decoder_t decoder;
+            huffman_decoder_init(&decoder, table);
+            bit_stream_t stream;
+            bit_stream_init(&stream, encoded, encoded_size, ENCODE_OUTPUT_SLACK);
+            
+            decoded &= huffman_decode_symbols(&decoder, &stream, output, size) == size &&
+                       memcmp(output, data, size) == 0;
+        }
+        
+        char name[96];
+        snprintf(name, sizeof(name), "stack decoder: round trip (pass %d)", pass);
+        check(decoded, name);
+        if (allocation_count) {
+            snprintf(name, sizeof(name), "stack decoder: no allocations (pass %d)", pass);
+            check(allocation_count() == allocations, name);
+        }
+        
+        code_table_destroy(code_table);
+        destroy_vectorized_lookup_table(table);
+    }
+    
+    free(data);
+    free(output);
+    free(encoded);
+}
+
+// Kraft sum of a set of code lengths, scaled by 2^32: at most 2^32 for a
+// prefix code, exactly 2^32 for a complete one
+static uint64_t kraft_sum(const uint8_t* code_lengths) {
+    uint64_t sum = 0;
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        if (code_lengths[i]) sum += (uint64_t)1 << (MAX_CODE_LENGTH - code_lengths[i]);
+    }
+    return sum;
+}
+
+static uint64_t encoded_bits(const frequency_table_t* freq_table, const uint8_t* code_lengths) {
+    uint64_t bits = 0;
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        bits += freq_table->frequencies[i] * code_lengths[i];
+    }
+    return bits;
+}
+
+// Length-limited codes for every limit from the alphabet's minimum up to
+// MAX_CODE_LENGTH: a prefix code, no code over the limit, every symbol
+// coded, and never cheaper than a looser limit allows. Below the minimum
+// the build must fail.
+static void check_limited_code_lengths(const frequency_table_t* freq_table, const char* name) {
+    char label[128];
+    const uint8_t minimum = huffman_min_code_length(freq_table->unique_symbols);
+    uint8_t code_lengths[MAX_SYMBOLS];
+    uint64_t previous_bits = UINT64_MAX;
+    
+    for (uint8_t limit = 1; limit <= MAX_CODE_LENGTH; limit++) {
+        int result = build_limited_code_lengths(freq_table, limit, code_lengths);
+        if (limit < minimum) {
+            snprintf(label, sizeof(label), "limited lengths (%s): limit %u below the minimum fails", name, limit);
+            check(result != 0, label);
+            continue;
+        }
+        
+        snprintf(label, sizeof(label), "limited lengths (%s): limit %u", name, limit);
+        int valid = result == 0 && kraft_sum(code_lengths) <= ((uint64_t)1 << MAX_CODE_LENGTH);
+        for (int i = 0; valid && i < MAX_SYMBOLS; i++) {
+            valid = code_lengths[i] <= limit && (code_lengths[i] != 0) == (freq_table->frequencies[i] != 0);
+        }
+        
+        // A looser limit can only make the code cheaper
+        uint64_t bits = valid ? encoded_bits(freq_table, code_lengths) : 0;
+        check(valid && bits <= previous_bits, label);
+        previous_bits = bits;
+    }
+}
+
+static void check_package_merge(void) {
+    frequency_table_t freq_table;
+    
+    // Fibonacci weights: plain Huffman would run one level deeper per symbol
+    memset(&freq_table, 0, sizeof(freq_table));
+    uint64_t a = 1, b = 1;
+    for (int i = 0; i < 60; i++) {
+        freq_table.frequencies[i] = a;
+        uint64_t next = a + b;
+        a = b;
+        b = next;
+    }
+    freq_table.unique_symbols = 60;
+    check_limited_code_lengths(&freq_table, "fibonacci");
+    
+    // Every byte value, equally likely then geometrically skewed
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        freq_table.frequencies[i] = 1000;
+    }
+    freq_table.unique_symbols = MAX_SYMBOLS;
+    check_limited_code_lengths(&freq_table, "uniform");
+    
+    for (int i = 0; i < MAX_SYMBOLS; i++) {
+        freq_table.frequencies[i] = (uint64_t)1 << (i % 40);
+    }
+    check_limited_code_lengths(&freq_table, "geometric");
+    
+    // 65 symbols need 7 bits; the smallest limit that fits must be exact
+    memset(&freq_table, 0, sizeof(freq_table));
+    for (int i = 0; i < 65; i++) {
+        freq_table.frequencies[i] = (uint64_t)i + 1;
+    }
+    freq_table.unique_symbols = 65;
+    check_limited_code_lengths(&freq_table, "65 symbols");
+    check(huffman_min_code_length(65) == 7 && huffman_min_code_length(64) == 6 &&
+          huffman_min_code_length(2) == 1 && huffman_min_code_length(1) == 1,
+          "minimum code length is ceil(log2(symbols))");
+    
+    // Limited codes round trip through the container
+    const size_t size = 200 * 1000;
+    uint8_t* data = malloc(size);
+    if (!data) {
+        check(0, "limited round trip: allocate input");
+        return;
+    }
+    fill_skewed(data, size, 7);
+    for (uint8_t limit = 5; limit <= 16; limit += 11) {
+        huffman_compress_options_t options = {0};
+        options.max_code_length = limit;
+        uint8_t* compressed;
+        size_t compressed_size;
+        uint8_t* output = NULL;
+        size_t output_size = 0;
+        int passed = huffman_compress_blocks(data, size, &options, &compressed, &compressed_size) == 0;
+        if (passed) {
+            passed = huffman_decompress_blocks(compressed, compressed_size, NULL, &output, &output_size) == 0 &&
+                     output_size == size && memcmp(output, data, size) == 0;
+            free(compressed);
+            free(output);
+        }
+        check(passed, "limited round trip");
+    }
+    free(data);
+}
+
+// Codes of 17 to 32 bits. Lengths 1..longest plus a second code of the
+// longest length form a complete code, and input drawn mostly from its long
+// end puts long codes side by side. The word-at-a-time encoder must match
+// the bit writer exactly and its output must decode.
+static void check_long_code_table(uint8_t longest) {
+    uint8_t code_lengths[MAX_SYMBOLS] = {0};
+    for (int i = 0; i < longest; i++) {
+        code_lengths[i] = (uint8_t)(i + 1);
+    }
+    code_lengths[longest] = longest;
+    size_t used = (size_t)longest + 1;
+    
+    const size_t size = 64 * 1024;
+    code_table_t* table = code_table_from_lengths(code_lengths);
+    bit_writer_t* writer = bit_writer_create();
+    uint8_t* data = malloc(size);
+    uint8_t* output = malloc(size);
+    uint8_t* encoded = malloc(size * 4 + ENCODE_OUTPUT_SLACK);
+    if (!table || !writer || !data || !output || !encoded) {
+        check(0, "long codes: allocate");
+    } else {
+        uint32_t seed = longest;
+        for (size_t i = 0; i < size; i++) {
+            seed = seed * 1103515245u + 12345u;
+            uint32_t r = seed >> 8;
+            data[i] = (uint8_t)((r & 3) ? 16 + (r >> 2) % (used - 16) : (r >> 2) % used);
+        }
+        
+        size_t encoded_size = huffman_encode_into(table, data, size, encoded);
+        
+        int written = 1;
+        for (size_t i = 0; i < size; i++) {
+            written &= bit_writer_write_code(writer, &table->codes[data[i]]) == 0;
+        }
+        size_t expected_size = 0;
+        const uint8_t* expected = (written && bit_writer_flush(writer) == 0)
+            ? bit_writer_get_data(writer, &expected_size) : NULL;
+        check(expected && encoded_size == expected_size && memcmp(encoded, expected, expected_size) == 0,
+              "long codes: word encoder matches the bit writer");
+        
+        symbol_info_t symbol_table[33];
+        for (size_t i = 0; i < used; i++) {
+            symbol_table[i].symbol = (uint8_t)i;
+            symbol_table[i].code_length = table->codes[i].length;
+            symbol_table[i].code = table->codes[i].code;
+        }
+        check(huffman_decompress_data_into(encoded, encoded_size, symbol_table, used, output, size) == 0 &&
+              memcmp(output, data, size) == 0, "long codes: decode");
+    }
+    
+    if (table) code_table_destroy(table);
+    if (writer) bit_writer_destroy(writer);
+    free(data);
+    free(output);
+    free(encoded);
+}
+
+static void check_long_codes(void) {
+    for (uint8_t longest = 17; longest <= 32; longest++) {
+        check_long_code_table(longest);
+    }
+    
+    // Whole-pipeline round trip: Fibonacci counts give codes of up to 29
+    // bits, with the rare symbols written first and next to each other
+    size_t total = 0;
+    uint64_t counts[30];
+    uint64_t a = 1, b = 1;
+    for (int i = 0; i < 30; i++) {
+        counts[i] = a;
+        total += a;
+        uint64_t next = a + b;
+        a = b;
+        b = next;
+    }
+    
+    uint8_t* input = malloc(total);
+    if (!input) {
+        check(0, "long codes: allocate round trip input");
+        return;
+    }
+    size_t position = 0;
+    for (int i = 0; i < 30; i++) {
+        memset(input + position, 'A' + i, counts[i]);
+        position += counts[i];
+    }
+    
+    uint8_t* compressed;
+    size_t compressed_size;
+    symbol_info_t* symbols;
+    size_t symbol_count;
+    if (huffman_compress_data(input, total, &compressed, &compressed_size, &symbols, &symbol_count) != 0) {
+        check(0, "long codes: compress");
+    } else {
+        uint8_t longest = 0;
+        for (size_t i = 0; i < symbol_count; i++) {
+            if (symbols[i].code_length > longest) longest = symbols[i].code_length;
+        }
+        uint8_t* decompressed = NULL;
+        size_t decompressed_size = 0;
+        check(longest > 16 &&
+              huffman_decompress_data(compressed, compressed_size, symbols, symbol_count,
+                                      &decompressed, &decompressed_size, total) == 0 &&
+              decompressed_size == total && memcmp(decompressed, input, total) == 0,
+              "long codes: round trip");
+        free(decompressed);
+        free(compressed);
+        free(symbols);
+    }
+    free(input);
+}
+
+// Everything written to a pipe, collected by a thread so the writer never
+// blocks on a full pipe
+typedef struct pipe_sink {
+    int fd;
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} pipe_sink_t;
+
+static void* drain_pipe(void* arg) {
+    pipe_sink_t* sink = arg;
+    for (;;) {
+        if (sink->size == sink->capacity) {
+            size_t capacity = sink->capacity ? sink->capacity * 2 : 65536;
+            uint8_t* data = realloc(sink->data, capacity);
+            if (!data) {
+                sink->failed = 1;
+                break;
+            }
+            sink->data = data;
+            sink->capacity = capacity;
+        }
+        ssize_t length = read(sink->fd, sink->data + sink->size, sink->capacity - sink->size);
+        if (length <= 0) {
+            sink->failed = length < 0;
+            break;
+        }
+        sink->size += (size_t)length;
+    }
+    close(sink->fd);
+    return NULL;
+}
+
+static int read_stream_file(FILE* file, uint8_t** output, size_t* output_size) {
+    long size = ftell(file);
+    if (size < 0 || fseek(file, 0, SEEK_SET) != 0) return -1;
+    
+    *output = malloc(size ? (size_t)size : 1);
+    *output_size = (size_t)size;
+    if (!*output || fread(*output, 1, *output_size, file) != *output_size) {
+        free(*output);
+        return -1;
+    }
+    return 0;
+}
+
+// Feeds a buffer into a pipe from a thread, then closes it, so a codec
+// reads an unseekable stream the way it reads stdin
+typedef struct pipe_source {
+    int fd;
+    const uint8_t* data;
+    size_t size;
+} pipe_source_t;
+
+static void* fill_pipe(void* arg) {
+    pipe_source_t* source = arg;
+    size_t written = 0;
+    while (written < source->size) {
+        ssize_t length = write(source->fd, source->data + written, source->size - written);
+        if (length <= 0) break;  // The reader gave up early
+        written += (size_t)length;
+    }
+    close(source->fd);
+    return NULL;
+}
+
+// Run the streaming compressor (or decompressor) over input. Input comes
+// from a temporary file or, with pipe_input, an unseekable pipe; output goes
+// to a temporary file or, with pipe_output, a pipe. Returns the codec's
+// result; on success *output holds what it wrote.
+static int run_stream(int compress, const uint8_t* input, size_t input_size, int pipe_input, int pipe_output,
+                      const huffman_compress_options_t* options, uint8_t** output, size_t* output_size) {
+    *output = NULL;
+    int in_fds[2] = {-1, -1};
+    int out_fds[2] = {-1, -1};
+    if ((pipe_input && pipe(in_fds) != 0) || (pipe_output && pipe(out_fds) != 0)) {
+        if (in_fds[0] >= 0) {
+            close(in_fds[0]);
+            close(in_fds[1]);
+        }
+        return -1;
+    }
+    
+    // A decoder that stops early leaves the feeding thread writing to a
+    // closed pipe; that must be an error return, not a signal
+    void (*previous_handler)(int) = signal(SIGPIPE, SIG_IGN);
+    
+    pipe_source_t source = {.fd = in_fds[1], .data = input, .size = input_size};
+    pipe_sink_t sink = {.fd = out_fds[0]};
+    pthread_t feeder, drainer;
+    int feeding = 0, draining = 0;
+    
+    FILE* source_file = pipe_input ? fdopen(in_fds[0], "rb") : tmpfile();
+    FILE* sink_file = pipe_output ? fdopen(out_fds[1], "wb") : tmpfile();
+    int result = -1;
+    if (source_file && sink_file) {
+        if (pipe_input) {
+            feeding = pthread_create(&feeder, NULL, fill_pipe, &source) == 0;
+        } else {
+            feeding = fwrite(input, 1, input_size, source_file) == input_size &&
+                      fseek(source_file, 0, SEEK_SET) == 0;
+        }
+        if (pipe_output) draining = pthread_create(&drainer, NULL, drain_pipe, &sink) == 0;
+        
+        if (feeding && (draining || !pipe_output)) {
+            result = compress ? huffman_compress_stream(source_file, sink_file, options, NULL, NULL)
+                              : huffman_decompress_stream(source_file, sink_file, NULL);
+        }
+        if (result == 0 && !pipe_output && read_stream_file(sink_file, output, output_size) != 0) result = -1;
+    }
+    
+    // Closing our ends lets both threads finish
+    if (source_file) fclose(source_file); else if (pipe_input) close(in_fds[0]);
+    if (sink_file) {
+        if (fclose(sink_file) != 0) result = -1;
+    } else if (pipe_output) {
+        close(out_fds[1]);
+    }
+    if (pipe_input) {
+        if (feeding) pthread_join(feeder, NULL); else close(in_fds[1]);
+    }
+    if (pipe_output) {
+        if (draining) pthread_join(drainer, NULL); else close(out_fds[0]);
+        if (sink.failed) result = -1;
+        if (result == 0) {
+            *output = sink.data;
+            *output_size = sink.size;
+        } else {
+            free(sink.data);
+        }
+    }
+    
+    signal(SIGPIPE, previous_handler);
+    return result;
+}
+
+// A damaged container must fail both the in-memory and the streaming decoder
+static void check_rejected(const uint8_t* container, size_t size, const char* name) {
+    uint8_t* output = NULL;
+    size_t output_size = 0;
+    huffman_decompress_options_t options = {.threads = 2};
+    int in_memory = huffman_decompress_blocks(container, size, &options, &output, &output_size);
+    if (in_memory == 0) free(output);
+    
+    int streamed = run_stream(0, container, size, 0, 0, NULL, &output, &output_size);
+    if (streamed == 0) free(output);
+    
+    check(in_memory != 0 && streamed != 0, name);
+}
+
+static int decodes_to(const uint8_t* container, size_t size, const uint8_t* data, size_t data_size) {
+    uint8_t* output = NULL;
+    size_t output_size = 0;
+    huffman_decompress_options_t options = {.threads = 3};
+    int matches = huffman_decompress_blocks(container, size, &options, &output, &output_size) == 0 &&
+                  output_size == data_size && memcmp(output, data, data_size) == 0;
+    free(output);
+    
+    matches = matches && run_stream(0, container, size, 0, 0, NULL, &output, &output_size) == 0 &&
+              output_size == data_size && memcmp(output, data, data_size) == 0;
+    free(output);
+    return matches;
+}
+
+// Truncation anywhere, and index entries or a trailer that disagree with the
+// blocks, must be caught
+static void check_damaged_container(const uint8_t* container, size_t size, const char* kind) {
+    huffman_block_index_t index;
+    uint8_t* copy = malloc(size);
+    if (!copy || huffman_read_block_index(container, size, &index) != 0) {
+        check(0, "streaming: read index");
+        free(copy);
+        return;
+    }
+    char name[96];
+    
+    const size_t cuts[] = {
+        0, sizeof(huffman_header_t), sizeof(huffman_header_t) + 7, index.entries[1].block_offset + 3,
+        index.blocks_end, index.index_offset + 5, size - sizeof(huffman_index_trailer_t), size - 1,
+    };
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+        snprintf(name, sizeof(name), "streaming (%s): truncated to %zu of %zu bytes", kind, cuts[i], size);
+        check_rejected(container, cuts[i], name);
+    }
+    
+    // Each index field off by one in turn
+    const size_t entry = index.index_offset + 2 * sizeof(huffman_index_entry_t);
+    const size_t fields[] = {
+        entry + offsetof(huffman_index_entry_t, original_offset),
+        entry + offsetof(huffman_index_entry_t, block_offset),
+        size - sizeof(huffman_index_trailer_t) + offsetof(huffman_index_trailer_t, original_size),
+        size - sizeof(huffman_index_trailer_t) + offsetof(huffman_index_trailer_t, block_count),
+        size - sizeof(huffman_index_trailer_t) + offsetof(huffman_index_trailer_t, block_size),
+        size - sizeof(huffman_index_trailer_t) + offsetof(huffman_index_trailer_t, checksum),
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        memcpy(copy, container, size);
+        copy[fields[i]]++;
+        snprintf(name, sizeof(name), "streaming (%s): index byte %zu disagrees with the blocks", kind, fields[i]);
+        check_rejected(copy, size, name);
+    }
+    free(copy);
+}
+
+// The streaming compressor against the in-memory one: a seekable output must
+// match it byte for byte, and an unseekable one must carry a streamed
+// container with an end marker that both decoders accept
+static void check_streaming(void) {
+    const size_t block_size = 4096;
+    const size_t size = 10 * block_size + 123;
+    uint8_t* data = malloc(size);
+    if (!data) {
+        check(0, "streaming: allocate");
+        return;
+    }
+    fill_skewed(data, size, 21);
+    
+    for (unsigned threads = 1; threads <= 3; threads += 2) {
+        huffman_compress_options_t options = {.block_size = block_size, .threads = threads};
+        uint8_t* expected = NULL;
+        size_t expected_size = 0;
+        uint8_t* seekable = NULL;
+        size_t seekable_size = 0;
+        uint8_t* streamed = NULL;
+        size_t streamed_size = 0;
+        
+        if (huffman_compress_blocks(data, size, &options, &expected, &expected_size) != 0 ||
+            run_stream(1, data, size, 0, 0, &options, &seekable, &seekable_size) != 0 ||
+            run_stream(1, data, size, 0, 1, &options, &streamed, &streamed_size) != 0) {
+            check(0, "streaming: compress");
+        } else {
+            check(seekable_size == expected_size && memcmp(seekable, expected, expected_size) == 0,
+                  "streaming: seekable output matches huffman_compress_blocks");
+            check(decodes_to(seekable, seekable_size, data, size), "streaming: seekable round trip");
+            
+            huffman_header_t header;
+            memcpy(&header, streamed, sizeof(header));
+            huffman_block_index_t index;
+            static const huffman_block_header_t end = {0};
+            check((header.flags & HUFFMAN_FLAG_STREAMED) && header.original_size == 0 &&
+                  huffman_read_block_index(streamed, streamed_size, &index) == 0 &&
+                  index.trailer.block_count == 11 && index.header.original_size == size &&
+                  memcmp(streamed + index.blocks_end, &end, sizeof(end)) == 0,
+                  "streaming: unseekable output is a streamed container with an end marker");
+            check(decodes_to(streamed, streamed_size, data, size), "streaming: streamed round trip");
+            
+            check_damaged_container(seekable, seekable_size, "seekable");
+            check_damaged_container(streamed, streamed_size, "streamed");
+            
+            // Without its end marker a streamed container runs into the index
+            uint8_t* markerless = malloc(streamed_size);
+            if (markerless && huffman_read_block_index(streamed, streamed_size, &index) == 0) {
+                const size_t marker = index.blocks_end;
+                const size_t rest = marker + sizeof(huffman_block_header_t);
+                memcpy(markerless, streamed, marker);
+                memcpy(markerless + marker, streamed + rest, streamed_size - rest);
+                check_rejected(markerless, streamed_size - sizeof(huffman_block_header_t),
+                               "streaming: streamed container without its end marker");
+            }
+            free(markerless);
+        }
+        free(expected);
+        free(seekable);
+        free(streamed);
+    }
+    
+    // Empty input still makes a container, with no blocks
+    uint8_t* empty = NULL;
+    size_t empty_size = 0;
+    huffman_compress_options_t options = {.block_size = block_size};
+    check(run_stream(1, data, 0, 0, 1, &options, &empty, &empty_size) == 0 && decodes_to(empty, empty_size, data, 0),
+          "streaming: empty input");
+    free(empty);
+    free(data);
+}
+
+// A version 1 file (header, symbol table, one bit stream) in memory
+static int make_single_container(const uint8_t* data, size_t size, uint8_t** output, size_t* output_size) {
+    uint8_t* compressed;
+    size_t compressed_size;
+    symbol_info_t* symbols;
+    size_t symbol_count;
+    if (huffman_compress_data(data, size, &compressed, &compressed_size, &symbols, &symbol_count) != 0) return -1;
+    
+    huffman_header_t header = {
+        .magic = HUFFMAN_MAGIC,
+        .version = HUFFMAN_VERSION_SINGLE,
+        .original_size = size,
+        .compressed_size = compressed_size,
+        .symbol_count = (uint16_t)symbol_count,
+        .checksum = calculate_crc32(data, size),
+    };
+    for (size_t i = 0; i < symbol_count; i++) {
+        if (symbols[i].code_length > header.max_code_length) header.max_code_length = symbols[i].code_length;
+    }
+    
+    const size_t table_size = symbol_count * sizeof(symbol_info_t);
+    *output_size = sizeof(header) + table_size + compressed_size;
+    *output = malloc(*output_size);
+    if (*output) {
+        memcpy(*output, &header, sizeof(header));
+        memcpy(*output + sizeof(header), symbols, table_size);
+        memcpy(*output + sizeof(header) + table_size, compressed, compressed_size);
+    }
+    free(compressed);
+    free(symbols);
+    return *output ? 0 : -1;
+}
+
+static int pipe_decodes_to(const uint8_t* container, size_t size, int pipe_output,
+                           const uint8_t* data, size_t data_size) {
+    uint8_t* output = NULL;
+    size_t output_size = 0;
+    int matches = run_stream(0, container, size, 1, pipe_output, NULL, &output, &output_size) == 0 &&
+                  output_size == data_size && memcmp(output, data, data_size) == 0;
+    free(output);
+    return matches;
+}
+
+// Pipes at both ends, as with `huffman -c - -`: unseekable input must give
+// the same container as a file, and every container kind must decode from
+// a pipe. Input is several times a pipe's buffer, so reads come in pieces.
+static void check_pipes(void) {
+    const size_t block_size = 4096;
+    const size_t size = 64 * block_size + 1000;
+    uint8_t* data = malloc(size);
+    if (!data) {
+        check(0, "pipes: allocate");
+        return;
+    }
+    fill_skewed(data, size, 22);
+    
+    huffman_compress_options_t options = {.block_size = block_size, .threads = 2};
+    uint8_t* expected = NULL;
+    size_t expected_size = 0;
+    uint8_t* streamed = NULL;
+    size_t streamed_size = 0;
+    uint8_t* piped = NULL;
+    size_t piped_size = 0;
+    uint8_t* to_file = NULL;
+    size_t to_file_size = 0;
+    uint8_t* single = NULL;
+    size_t single_size = 0;
+    
+    if (huffman_compress_blocks(data, size, &options, &expected, &expected_size) != 0 ||
+        run_stream(1, data, size, 0, 1, &options, &streamed, &streamed_size) != 0 ||
+        run_stream(1, data, size, 1, 1, &options, &piped, &piped_size) != 0 ||
+        run_stream(1, data, size, 1, 0, &options, &to_file, &to_file_size) != 0 ||
+        make_single_container(data, size, &single, &single_size) != 0) {
+        check(0, "pipes: compress");
+    } else {
+        check(piped_size == streamed_size && memcmp(piped, streamed, streamed_size) == 0,
+              "pipes: piped input gives the same streamed container");
+        check(to_file_size == expected_size && memcmp(to_file, expected, expected_size) == 0,
+              "pipes: piped input to a file matches huffman_compress_blocks");
+        
+        for (int pipe_output = 0; pipe_output <= 1; pipe_output++) {
+            check(pipe_decodes_to(expected, expected_size, pipe_output, data, size),
+                  "pipes: seekable container from a pipe");
+            check(pipe_decodes_to(streamed, streamed_size, pipe_output, data, size),
+                  "pipes: streamed container from a pipe");
+            check(pipe_decodes_to(single, single_size, pipe_output, data, size),
+                  "pipes: version 1 file from a pipe");
+        }
+        
+        // Failures part way through a pipe: an early one leaves most of the
+        // input unread, a late one reads to the end
+        check(!pipe_decodes_to(streamed, streamed_size - 1, 1, data, size), "pipes: truncated container");
+        streamed[sizeof(huffman_header_t)] ^= 1;
+        check(!pipe_decodes_to(streamed, streamed_size, 1, data, size), "pipes: damaged first block");
+    }
+    
+    free(expected);
+    free(streamed);
+    free(piped);
+    free(to_file);
+    free(single);
+    free(data);
+}
+
+// Write a buffer to a new temporary file; its path goes in path
+static int write_temp_file(const uint8_t* data, size_t size, char* path) {
+    strcpy(path, "/tmp/huffman_range_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    
+    FILE* file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    int result = fwrite(data, 1, size, file) == size ? 0 : -1;
+    if (fclose(file) != 0) result = -1;
+    if (result != 0) unlink(path);
+    return result;
+}
+
+// huffman_decompress_file_range into memory; -1 on failure
+static int read_file_range(const char* path, uint64_t start, uint64_t end, uint8_t** output, size_t* output_size) {
+    *output = NULL;
+    FILE* file = tmpfile();
+    if (!file) return -1;
+    
+    int result = huffman_decompress_file_range(path, file, start, end);
+    if (result == 0) result = read_stream_file(file, output, output_size);
+    fclose(file);
+    return result;
+}
+
+static int file_range_is(const char* path, uint64_t start, uint64_t end, const uint8_t* expected, size_t length) {
+    uint8_t* output;
+    size_t output_size;
+    int matches = read_file_range(path, start, end, &output, &output_size) == 0 &&
+                  output_size == length && memcmp(output, expected, length) == 0;
+    free(output);
+    return matches;
+}
+
+// Random access through the block index, in memory and from a file: ranges
+// inside one block, across boundaries, to the end, and empty; a range that
+// starts past the end, and a version 1 file, must fail
+static void check_ranges(void) {
+    const size_t block_size = 4096;
+    const size_t size = 10 * block_size + 123;
+    uint8_t* data = malloc(size);
+    uint8_t* output = malloc(size);
+    uint8_t* container = NULL;
+    size_t container_size = 0;
+    uint8_t* single = NULL;
+    size_t single_size = 0;
+    huffman_compress_options_t options = {.block_size = block_size};
+    huffman_block_index_t index;
+    
+    if (!data || !output) {
+        check(0, "ranges: allocate");
+        free(data);
+        free(output);
+        return;
+    }
+    fill_skewed(data, size, 25);
+    if (huffman_compress_blocks(data, size, &options, &container, &container_size) != 0 ||
+        huffman_read_block_index(container, container_size, &index) != 0 ||
+        make_single_container(data, size, &single, &single_size) != 0) {
+        check(0, "ranges: compress");
+        free(data);
+        free(output);
+        free(container);
+        free(single);
+        return;
+    }
+    
+    const struct {
+        uint64_t start, end;
+        const char* name;
+    } ranges[] = {
+        {100, 200, "inside one block"},
+        {block_size - 100, block_size + 100, "across a block boundary"},
+        {1000, 7 * block_size + 5, "across several blocks"},
+        {2 * block_size, 3 * block_size, "exactly one block"},
+        {size - 50, size, "inside the short last block"},
+        {0, size, "everything"},
+        {block_size, block_size, "empty, on a boundary"},
+        {size, size, "empty, at the end"},
+    };
+    char name[96];
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        const uint64_t start = ranges[i].start, end = ranges[i].end;
+        snprintf(name, sizeof(name), "ranges: huffman_decode_range %s", ranges[i].name);
+        check(huffman_decode_range(container, &index, start, end, output) == 0 &&
+              memcmp(output, data + start, end - start) == 0, name);
+    }
+    check(huffman_decode_range(container, &index, size - 10, size + 1, output) != 0 &&
+          huffman_decode_range(container, &index, size + 1, size + 2, output) != 0 &&
+          huffman_decode_range(container, &index, 200, 100, output) != 0,
+          "ranges: huffman_decode_range outside the data");
+    
+    char path[32];
+    char single_path[32];
+    if (write_temp_file(container, container_size, path) != 0) {
+        check(0, "ranges: write container file");
+    } else {
+        for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+            const uint64_t start = ranges[i].start, end = ranges[i].end;
+            snprintf(name, sizeof(name), "ranges: file range %s", ranges[i].name);
+            check(file_range_is(path, start, end, data + start, end - start), name);
+        }
+        
+        // An open end, or one past the data, stops at the end of the data
+        check(file_range_is(path, 5 * block_size + 7, UINT64_MAX, data + 5 * block_size + 7,
+                            size - 5 * block_size - 7), "ranges: file range A: to the end");
+        check(file_range_is(path, size - 10, size + 1000, data + size - 10, 10), "ranges: file range end clamped");
+        check(file_range_is(path, size, UINT64_MAX, data, 0), "ranges: file range starting at the end");
+        
+        uint8_t* rejected;
+        size_t rejected_size;
+        check(read_file_range(path, size + 1, UINT64_MAX, &rejected, &rejected_size) != 0 &&
+              read_file_range(path, size + 1, size + 10, &rejected, &rejected_size) != 0,
+              "ranges: file range starting past the end");
+        unlink(path);
+        
+        if (write_temp_file(single, single_size, single_path) != 0) {
+            check(0, "ranges: write version 1 file");
+        } else {
+            check(read_file_range(single_path, 0, 10, &rejected, &rejected_size) != 0,
+                  "ranges: version 1 file rejected");
+            unlink(single_path);
+        }
+    }
+    
+    free(data);
+    free(output);
+    free(container);
+    free(single);
+}
+
+// Bit-at-a-time CRC-32 register update: the definition every kernel must match
+static uint32_t crc32_reference(uint32_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return crc;
+}
+
+// The CRC kernel dispatch picked for this host, against the standard check
+// value and the bitwise definition at every length and alignment around the
+// folding kernels' 64-byte steps, and resumed part way through a buffer
+static void check_crc32(void) {
+    const huffman_kernels_t* kernels = huffman_kernels();
+    char name[96];
+    
+    snprintf(name, sizeof(name), "crc32 (%s): check value", kernels->crc32_variant);
+    check(calculate_crc32((const uint8_t*)"123456789", 9) == 0xCBF43926u, name);
+    
+    const size_t size = 70000;
+    uint8_t* data = malloc(size);
+    if (!data) {
+        check(0, "crc32: allocate");
+        return;
+    }
+    fill_random(data, size, 18);
+    
+    int matches = 1;
+    for (size_t offset = 0; offset < 16; offset++) {
+        for (size_t length = 0; length <= 300; length++) {
+            matches &= kernels->crc32_update(0xFFFFFFFFu, data + offset, length) ==
+                       crc32_reference(0xFFFFFFFFu, data + offset, length);
+        }
+    }
+    snprintf(name, sizeof(name), "crc32 (%s): lengths 0-300 at offsets 0-15", kernels->crc32_variant);
+    check(matches, name);
+    
+    const size_t lengths[] = {1000, 4099, 65536 + 7, 69999};
+    matches = 1;
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        const uint32_t expected = crc32_reference(0xFFFFFFFFu, data + 1, lengths[i]);
+        const size_t split = lengths[i] / 3;
+        uint32_t crc = kernels->crc32_update(0xFFFFFFFFu, data + 1, split);
+        crc = kernels->crc32_update(crc, data + 1 + split, lengths[i] - split);
+        matches &= kernels->crc32_update(0xFFFFFFFFu, data + 1, lengths[i]) == expected && crc == expected;
+    }
+    snprintf(name, sizeof(name), "crc32 (%s): long and resumed buffers", kernels->crc32_variant);
+    check(matches, name);
+    
+    free(data);
+}
+
+// Worker threads only change who encodes each block: at any thread count
+// the container must match the single-threaded one byte for byte. Sizes
+// leave a short last block and more blocks than threads, and alternating
+// uniform and skewed stretches give neighbouring blocks different tables.
+static void check_thread_counts(void) {
+    const size_t block_sizes[] = {4096, 10000, 65536};
+    const unsigned thread_counts[] = {2, 3, 8};
+    char name[96];
+    
+    for (size_t s = 0; s < sizeof(block_sizes) / sizeof(block_sizes[0]); s++) {
+        const size_t block_size = block_sizes[s];
+        const size_t size = 21 * block_size + 777;
+        uint8_t* data = malloc(size);
+        if (!data) {
+            check(0, "threads: allocate");
+            return;
+        }
+        const size_t stretch = block_size * 3 / 2;
+        for (size_t i = 0; i * stretch < size; i++) {
+            const size_t length = (size - i * stretch < stretch) ? size - i * stretch : stretch;
+            if (i & 1) {
+                fill_random(data + i * stretch, length, (uint32_t)i);
+            } else {
+                fill_skewed(data + i * stretch, length, (uint32_t)i);
+            }
+        }
+        
+        huffman_compress_options_t options = {.block_size = block_size, .threads = 1};
+        uint8_t* expected = NULL;
+        size_t expected_size = 0;
+        if (huffman_compress_blocks(data, size, &options, &expected, &expected_size) != 0) {
+            check(0, "threads: compress");
+            free(data);
+            return;
+        }
+        
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            options.threads = thread_counts[t];
+            uint8_t* output = NULL;
+            size_t output_size = 0;
+            snprintf(name, sizeof(name), "threads: %u threads, %zu-byte blocks match 1 thread",
+                     thread_counts[t], block_size);
+            check(huffman_compress_blocks(data, size, &options, &output, &output_size) == 0 &&
+                  output_size == expected_size && memcmp(output, expected, expected_size) == 0, name);
+            free(output);
+            
+            snprintf(name, sizeof(name), "threads: %u-thread stream, %zu-byte blocks match 1 thread",
+                     thread_counts[t], block_size);
+            check(run_stream(1, data, size, 0, 0, &options, &output, &output_size) == 0 &&
+                  output_size == expected_size && memcmp(output, expected, expected_size) == 0, name);
+            free(output);
+        }
+        
+        free(expected);
+        free(data);
+    }
+}
+
+// crc32_update over `length` zero bytes, fed through one small buffer
+static uint32_t crc32_update_zeros(uint32_t crc, uint64_t length, const uint8_t* zeros, size_t zeros_size) {
+    const huffman_kernels_t* kernels = huffman_kernels();
+    while (length > 0) {
+        const size_t step = (length < zeros_size) ? (size_t)length : zeros_size;
+        crc = kernels->crc32_update(crc, zeros, step);
+        length -= step;
+    }
+    return crc;
+}
+
+// Every file CRC is combined from block CRCs: combine(crc(A), crc(B), |B|)
+// must equal crc(A B) for any split, empty halves included, and for a B of
+// more than 2^32 bits, where the shift runs past the x^(2^k) table
+static void check_crc32_combine(void) {
+    const size_t size = 100000;
+    uint8_t* data = malloc(size);
+    uint8_t* zeros = calloc(1, 65536);
+    if (!data || !zeros) {
+        check(0, "crc32 combine: allocate");
+        free(data);
+        free(zeros);
+        return;
+    }
+    fill_random(data, size, 19);
+    
+    int matches = 1;
+    uint32_t seed = 19;
+    for (int i = 0; i < 300; i++) {
+        seed = seed * 1103515245u + 12345u;
+        size_t length = (i < 100) ? 1000 : (seed >> 8) % size;
+        seed = seed * 1103515245u + 12345u;
+        size_t split = (length == 0 || i % 50 == 0) ? 0 : (i % 50 == 1) ? length : (seed >> 8) % (length + 1);
+        
+        const uint32_t whole = calculate_crc32(data, length);
+        const uint32_t combined = calculate_crc32_combine(calculate_crc32(data, split),
+                                                          calculate_crc32(data + split, length - split),
+                                                          length - split);
+        matches &= combined == whole;
+    }
+    check(matches, "crc32 combine: random splits, empty halves included");
+    
+    // A, then 512 MiB and a bit of zeros, then B: the tail is 2^32 + bits
+    const size_t a_length = 1234;
+    const size_t b_length = 4321;
+    const uint64_t zero_length = ((uint64_t)1 << 29) + 4099;
+    const uint64_t tail_length = zero_length + b_length;
+    const huffman_kernels_t* kernels = huffman_kernels();
+    
+    uint32_t whole = kernels->crc32_update(0xFFFFFFFFu, data, a_length);
+    whole = crc32_update_zeros(whole, zero_length, zeros, 65536);
+    whole = kernels->crc32_update(whole, data + a_length, b_length) ^ 0xFFFFFFFFu;
+    
+    uint32_t tail = crc32_update_zeros(0xFFFFFFFFu, zero_length, zeros, 65536);
+    tail = kernels->crc32_update(tail, data + a_length, b_length) ^ 0xFFFFFFFFu;
+    
+    check(calculate_crc32_combine(calculate_crc32(data, a_length), tail, tail_length) == whole,
+          "crc32 combine: second half over 2^32 bits");
+    
+    free(data);
+    free(zeros);
+}
+
+int run_correctness_checks(size_t (*allocation_count)(void)) {
+    failed_checks = 0;
+    
+    if (allocation_count) {
+        check_cached_decode_allocations(allocation_count);
+    } else {
+        printf("Allocation checks skipped: allocations are not counted in this build\n");
+    }
+    check_stack_decoder(allocation_count);
+    check_crc32();
+    check_crc32_combine();
+    check_package_merge();
+    check_long_codes();
+    check_streaming();
+    check_thread_counts();
+    check_pipes();
+    check_ranges();
+    
+    return failed_checks;
+}
@@ -1,38 +1,237 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
 #include "huffman_compress.h"
+#include "block_container.h"
+#include "file_map.h"
+#include "cpu_dispatch.h"
+
+// stdio buffer for pipes, so blocks move in a few large reads and writes
+#define PIPE_BUFFER_SIZE (1 << 20)
 
 void print_usage(const char* program_name) {
     printf("M4-Optimized Huffman Compressor\n");
-    printf("Usage: %s [OPTIONS] INPUT_FILE OUTPUT_FILE\n\n", program_name);
+    printf("Usage: %s [OPTIONS] INPUT_FILE OUTPUT_FILE\n", program_name);
+    printf("       A file name of - means standard input or output\n\n");
     printf("Options:\n");
     printf("  -c, --compress     Compress input file (default)\n");
     printf("  -d, --decompress   Decompress input file\n");
     printf("  -t, --test         Test compressed file integrity\n");
+    printf("  -s, --stream       Work block by block in constant memory (large files)\n");
+    printf("      --stdin        Read standard input; only OUTPUT_FILE is given\n");
+    printf("      --stdout       Write standard output; only INPUT_FILE is given\n");
+    printf("  -L, --max-code-length N\n");
+    printf("                     Limit codes to N bits when compressing (1-32)\n");
+    printf("  -T, --threads N    Compress or decompress blocks on N threads (1-%d)\n", HUFFMAN_MAX_THREADS);
+    printf("      --range A:B    Decompress only bytes A to B (B excluded, default the end)\n");
     printf("  -v, --verbose      Enable verbose output\n");
     printf("  -h, --help         Show this help message\n\n");
     printf("Examples:\n");
     printf("  %s -c input.txt compressed.huf    # Compress file\n", program_name);
     printf("  %s -d compressed.huf output.txt   # Decompress file\n", program_name);
+    printf("  %s -L 11 input.txt compressed.huf # Compress with codes of at most 11 bits\n", program_name);
+    printf("  %s -s -c huge.log huge.huf        # Compress a file larger than memory\n", program_name);
+    printf("  %s -T 8 -c huge.log huge.huf      # Compress on 8 threads\n", program_name);
+    printf("  %s -T 8 -d huge.huf huge.log      # Decompress on 8 threads\n", program_name);
+    printf("  tar cf - dir | %s -c - - | ssh host 'cat > dir.huf'\n", program_name);
+    printf("  %s -d --range 4096:8192 app.huf - # Read 4 KiB from the middle\n", program_name);
     printf("  %s -t compressed.huf              # Test file integrity\n", program_name);
 }
 
 void print_version(void) {
+    const huffman_kernels_t* kernels = huffman_kernels();
+    
     printf("M4-Optimized Huffman Compressor v1.0\n");
     printf("Optimized for Apple Silicon (M1/M2/M3/M4)\n");
     printf("Built with ARM64 optimizations\n");
+    printf("Runtime kernels: decode=%s histogram=%s crc32=%s\n",
+           kernels->decode_variant, kernels->histogram_variant, kernels->crc32_variant);
+}
+
+// Compress or decompress between stdio streams, "-" naming stdin or stdout.
+// Pipes can be neither mapped nor seeked, so this is always the streaming
+// path, and nothing but data goes to stdout.
+static int run_streams(int compress, const char* input_file, const char* output_file,
+                       const huffman_compress_options_t* options, int verbose) {
+    const int from_stdin = strcmp(input_file, "-") == 0;
+    const int to_stdout = strcmp(output_file, "-") == 0;
+    
+    FILE* input = from_stdin ? stdin : fopen(input_file, "rb");
+    if (!input) return -1;
+    
+    FILE* output = to_stdout ? stdout : fopen(output_file, "wb");
+    if (!output) {
+        if (!from_stdin) fclose(input);
+        return -1;
+    }
+    
+    setvbuf(input, NULL, _IOFBF, PIPE_BUFFER_SIZE);
+    setvbuf(output, NULL, _IOFBF, PIPE_BUFFER_SIZE);
+    
+    uint64_t original_size = 0;
+    uint64_t compressed_size = 0;
+    int result = compress ? huffman_compress_stream(input, output, options, &original_size, &compressed_size)
+                          : huffman_decompress_stream(input, output, &original_size);
+    
+    if (!from_stdin) fclose(input);
+    if (to_stdout) {
+        if (fflush(stdout) != 0) result = -1;
+    } else {
+        if (fclose(output) != 0) result = -1;
+        if (result != 0) remove(output_file);
+    }
+    
+    if (result == 0 && verbose) {
+        if (compress) {
+            fprintf(stderr, "Compressed %llu bytes to %llu bytes\n",
+                    (unsigned long long)original_size, (unsigned long long)compressed_size);
+        } else {
+            fprintf(stderr, "Decompressed %llu bytes\n", (unsigned long long)original_size);
+        }
+    }
+    
+    return result;
+}
+
+// Most distinct byte values in any block of a file, split the way the
+// compressor splits it; 0 if the file cannot be read
+static size_t most_symbols_per_block(const char* path, size_t block_size) {
+    FILE* file = fopen(path, "rb");
+    uint8_t* block = malloc(block_size);
+    size_t most = 0;
+    
+    size_t length;
+    while (file && block && (length = fread(block, 1, block_size, file)) > 0) {
+        uint8_t seen[256] = {0};
+        size_t symbols = 0;
+        for (size_t i = 0; i < length; i++) {
+            symbols += !seen[block[i]];
+            seen[block[i]] = 1;
+        }
+        if (symbols > most) most = symbols;
+    }
+    
+    if (!file || !block || ferror(file)) most = 0;
+    if (file) fclose(file);
+    free(block);
+    return most;
+}
+
+// Explain a compress failure caused by -L: codes of at most N bits give at
+// most 2^N symbols distinct codes. 0 if the limit was not the cause.
+static int report_code_length_limit(const char* input_file, unsigned bits) {
+    if (bits == 0 || bits >= huffman_min_code_length(MAX_SYMBOLS)) return 0;
+    
+    size_t symbols = strcmp(input_file, "-") == 0 ? 0
+                                                  : most_symbols_per_block(input_file, HUFFMAN_DEFAULT_BLOCK_SIZE);
+    if (symbols == 0) {
+        // Standard input cannot be read again to count
+        fprintf(stderr, "Error: Operation failed; a code length limit of %u codes at most %u distinct "
+                "byte values per block\n", bits, 1u << bits);
+        return 1;
+    }
+    
+    const unsigned needed = huffman_min_code_length(symbols);
+    if (bits >= needed) return 0;
+    
+    fprintf(stderr, "Error: Code length limit %u is below ceil(log2(%zu)) = %u: a block has %zu distinct "
+            "byte values\n", bits, symbols, needed, symbols);
+    return 1;
+}
+
+// Parse "A:B" (or "A:" for the rest of the data) into [start, end)
+static int parse_range(const char* text, uint64_t* start, uint64_t* end) {
+    char* colon;
+    errno = 0;
+    unsigned long long from = strtoull(text, &colon, 10);
+    if (colon == text || *colon != ':' || text[0] == '-' || errno != 0) return -1;
+    
+    const char* rest = colon + 1;
+    if (*rest == '\0') {
+        *start = from;
+        *end = UINT64_MAX;
+        return 0;
+    }
+    
+    char* tail;
+    unsigned long long to = strtoull(rest, &tail, 10);
+    if (*tail != '\0' || rest[0] == '-' || errno != 0 || to < from) return -1;
+    
+    *start = from;
+    *end = to;
+    return 0;
+}
+
+// Decompress a slice of a container file to a file or to stdout
+static int run_range(const char* input_file, const char* output_file, uint64_t start, uint64_t end) {
+    const int to_stdout = strcmp(output_file, "-") == 0;
+    FILE* output = to_stdout ? stdout : fopen(output_file, "wb");
+    if (!output) return -1;
+    
+    int result = huffman_decompress_file_range(input_file, output, start, end);
+    if (to_stdout) {
+        if (fflush(stdout) != 0) result = -1;
+    } else {
+        if (fclose(output) != 0) result = -1;
+        if (result != 0) remove(output_file);
+    }
+    
+    return result;
+}
+
+// Explain a --range failure that comes from the file or the range rather
+// than from a damaged block. 0 if none of these was the cause.
+static int report_range_failure(const char* input_file, uint64_t start) {
+    file_map_t input;
+    if (file_map_open_read(input_file, &input) != 0) {
+        fprintf(stderr, "Error: Cannot read %s\n", input_file);
+        return 1;
+    }
+    
+    huffman_header_t header = {0};
+    if (input.size >= sizeof(header)) memcpy(&header, input.data, sizeof(header));
+    
+    huffman_block_index_t index;
+    int reported = 1;
+    if (header.magic == HUFFMAN_MAGIC && header.version == HUFFMAN_VERSION_SINGLE) {
+        fprintf(stderr, "Error: %s is a version 1 file, which has no block index for --range; "
+                "decompress it whole or compress it again\n", input_file);
+    } else if (huffman_read_block_index(input.data, input.size, &index) != 0) {
+        fprintf(stderr, "Error: %s is not a valid container\n", input_file);
+    } else if (start > index.header.original_size) {
+        fprintf(stderr, "Error: Range start %llu is past the end of the data (%llu bytes)\n",
+                (unsigned long long)start, (unsigned long long)index.header.original_size);
+    } else {
+        reported = 0;
+    }
+    
+    file_map_close(&input);
+    return reported;
 }
 
 int main(int argc, char* argv[]) {
     int compress_mode = 1;  // 1 = compress, 0 = decompress, -1 = test
     int verbose = 0;
+    int streaming = 0;
+    int use_stdin = 0;
+    int use_stdout = 0;
+    int ranged = 0;
+    uint64_t range_start = 0;
+    uint64_t range_end = 0;
+    huffman_compress_options_t options = {0};
     
     static struct option long_options[] = {
         {"compress",    no_argument, 0, 'c'},
         {"decompress",  no_argument, 0, 'd'},
         {"test",        no_argument, 0, 't'},
+        {"stream",      no_argument, 0, 's'},
+        {"stdin",       no_argument, 0, 'I'},
+        {"stdout",      no_argument, 0, 'O'},
+        {"max-code-length", required_argument, 0, 'L'},
+        {"threads",     required_argument, 0, 'T'},
+        {"range",       required_argument, 0, 'R'},
         {"verbose",     no_argument, 0, 'v'},
         {"help",        no_argument, 0, 'h'},
         {"version",     no_argument, 0, 'V'},
@@ -42,7 +241,7 @@ int main(int argc, char* argv[]) {
     int option_index = 0;
     int c;
     
-    while ((c = getopt_long(argc, argv, "cdtvhV", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "cdtsL:T:vhV", long_options, &option_index)) != -1) {
         switch (c) {
             case 'c':
                 compress_mode = 1;
@@ -53,6 +252,42 @@ int main(int argc, char* argv[]) {
             case 't':
                 compress_mode = -1;
                 break;
+            case 's':
+                streaming = 1;
+                break;
+            case 'I':
+                use_stdin = 1;
+                break;
+            case 'O':
+                use_stdout = 1;
+                break;
+            case 'L': {
+                char* end;
+                long bits = strtol(optarg, &end, 10);
+                if (*end != '\0' || bits < 1 || bits > MAX_CODE_LENGTH) {
+                    fprintf(stderr, "Error: Invalid code length limit '%s'\n", optarg);
+                    return 1;
+                }
+                options.max_code_length = (uint8_t)bits;
+                break;
+            }
+            case 'T': {
+                char* end;
+                long threads = strtol(optarg, &end, 10);
+                if (*end != '\0' || threads < 1 || threads > HUFFMAN_MAX_THREADS) {
+                    fprintf(stderr, "Error: Invalid thread count '%s'\n", optarg);
+                    return 1;
+                }
+                options.threads = (unsigned)threads;
+                break;
+            }
+            case 'R':
+                if (parse_range(optarg, &range_start, &range_end) != 0) {
+                    fprintf(stderr, "Error: Invalid range '%s'\n", optarg);
+                    return 1;
+                }
+                ranged = 1;
+                break;
             case 'v':
                 verbose = 1;
                 break;
@@ -95,35 +330,60 @@ int main(int argc, char* argv[]) {
         }
     } else {
         // Compress/decompress mode - needs input and output files
-        if (optind + 1 >= argc) {
+        if (optind + 2 - use_stdin - use_stdout > argc) {
             fprintf(stderr, "Error: Missing input and/or output file\n");
             print_usage(argv[0]);
             return 1;
         }
         
-        const char* input_file = argv[optind];
-        const char* output_file = argv[optind + 1];
+        const char* input_file = use_stdin ? "-" : argv[optind++];
+        const char* output_file = use_stdout ? "-" : argv[optind];
+        const int piped = strcmp(input_file, "-") == 0 || strcmp(output_file, "-") == 0;
         
+        // Status goes to stderr when stdout carries the data
+        FILE* info = strcmp(output_file, "-") == 0 ? stderr : stdout;
         if (verbose) {
-            printf("Input file:  %s\n", input_file);
-            printf("Output file: %s\n", output_file);
-            printf("Mode: %s\n", compress_mode ? "Compress" : "Decompress");
+            fprintf(info, "Input file:  %s\n", input_file);
+            fprintf(info, "Output file: %s\n", output_file);
+            fprintf(info, "Mode: %s\n", compress_mode ? "Compress" : "Decompress");
+        }
+        
+        if (ranged && compress_mode != 0) {
+            fprintf(stderr, "Error: --range applies to decompression (-d)\n");
+            return 1;
+        }
+        if (ranged && strcmp(input_file, "-") == 0) {
+            // The index that locates blocks sits at the end of the file
+            fprintf(stderr, "Error: --range needs a container file, not standard input\n");
+            return 1;
         }
         
         int result;
-        if (compress_mode) {
+        if (ranged) {
+            result = run_range(input_file, output_file, range_start, range_end);
+        } else if (piped) {
+            result = run_streams(compress_mode, input_file, output_file, &options, verbose);
+        } else if (compress_mode) {
             if (verbose) printf("Starting compression...\n");
-            result = huffman_compress_file(input_file, output_file);
+            result = streaming ? huffman_compress_file_streaming(input_file, output_file, &options)
+                               : huffman_compress_file_with_options(input_file, output_file, &options);
         } else {
             if (verbose) printf("Starting decompression...\n");
-            result = huffman_decompress_file(input_file, output_file);
+            huffman_decompress_options_t decompress_options = {.threads = options.threads};
+            result = streaming ? huffman_decompress_file_streaming(input_file, output_file)
+                               : huffman_decompress_file_with_options(input_file, output_file,
+                                                                      &decompress_options);
         }
         
         if (result == 0) {
-            if (verbose) printf("Operation completed successfully!\n");
+            if (verbose) fprintf(info, "Operation completed successfully!\n");
             return 0;
         } else {
-            fprintf(stderr, "Error: Operation failed\n");
+            int explained = ranged ? report_range_failure(input_file, range_start)
+                          : compress_mode && report_code_length_limit(input_file, options.max_code_length);
+            if (!explained) {
+                fprintf(stderr, "Error: Operation failed\n");
+            }
             return 1;
         }
     }
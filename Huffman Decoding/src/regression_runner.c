@@ -4,6 +4,44 @@
 #include <getopt.h>
 #include "regression_test.h"
 
+#ifdef REGRESSION_COUNT_ALLOCATIONS
+// Linked with --wrap for each allocator, so every heap allocation the
+// library makes is counted here on its way to the C library
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+
+static size_t allocations;
+
+void* __wrap_malloc(size_t size) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_realloc(pointer, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_aligned_alloc(alignment, size);
+}
+
+static size_t allocation_count(void) {
+    return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+#define ALLOCATION_COUNT allocation_count
+#else
+#define ALLOCATION_COUNT NULL
+#endif
+
 void print_usage(const char* program_name) {
     printf("Huffman Compression Regression Test Suite\n");
     printf("Usage: %s [OPTIONS]\n\n", program_name);
@@ -15,6 +53,7 @@ void print_usage(const char* program_name) {
     printf("  -g, --generate        Generate test files if missing\n");
     printf("  -V, --validate        Validate test files only\n");
     printf("  -s, --summary         Show summary only (less verbose)\n");
+    printf("  -k, --checks          Run the correctness checks only\n");
     printf("  -h, --help            Show this help message\n\n");
     printf("Examples:\n");
     printf("  %s -v \"baseline\" -i 50 -o baseline.json\n", program_name);
@@ -30,6 +69,7 @@ int main(int argc, char* argv[]) {
     int generate_files = 0;
     int validate_only = 0;
     int summary_only = 0;
+    int checks_only = 0;
     
     static struct option long_options[] = {
         {"version",    required_argument, 0, 'v'},
@@ -39,12 +79,13 @@ int main(int argc, char* argv[]) {
         {"generate",   no_argument,       0, 'g'},
         {"validate",   no_argument,       0, 'V'},
         {"summary",    no_argument,       0, 's'},
+        {"checks",     no_argument,       0, 'k'},
         {"help",       no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
     
     int c;
-    while ((c = getopt_long(argc, argv, "v:i:o:c:gVsh", long_options, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "v:i:o:c:gVskh", long_options, NULL)) != -1) {
         switch (c) {
             case 'v':
                 version_id = optarg;
@@ -71,6 +112,9 @@ int main(int argc, char* argv[]) {
             case 's':
                 summary_only = 1;
                 break;
+            case 'k':
+                checks_only = 1;
+                break;
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -80,6 +124,17 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    // Correctness checks run before any timing; they need no test files
+    int failed_checks = run_correctness_checks(ALLOCATION_COUNT);
+    if (failed_checks > 0) {
+        printf("Correctness checks: %d FAILED\n", failed_checks);
+        return 1;
+    }
+    printf("Correctness checks: all passed\n");
+    if (checks_only) {
+        return 0;
+    }
+    
     // Handle generate files option
     if (generate_files) {
         printf("Generating fixed test files...\n");